@@ -0,0 +1,386 @@
+/// Routines to manage the sector buffer cache.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "buffer_cache.hh"
+#include "synch_disk.hh"
+#include "threads/system.hh"
+
+#include <algorithm>
+#include <string.h>
+
+
+BufferCache::BufferCache(SynchDisk *disk_, unsigned numBuffers_)
+{
+    ASSERT(disk_ != nullptr);
+    ASSERT(numBuffers_ > 0);
+
+    disk = disk_;
+    numBuffers = numBuffers_;
+    buffers = new Buffer [numBuffers];
+    for (unsigned i = 0; i < numBuffers; i++) {
+        buffers[i].sector = -1;
+        buffers[i].dirty = false;
+        buffers[i].users = 0;
+        buffers[i].readAhead = false;
+        buffers[i].io = nullptr;
+        buffers[i].lock = new Lock("sector buffer lock");
+        buffers[i].colder = (int) i - 1;
+        buffers[i].warmer = i + 1 < numBuffers ? (int) i + 1 : -1;
+    }
+    coldest = 0;
+    warmest = numBuffers - 1;
+    where = new int [NUM_SECTORS];
+    for (unsigned i = 0; i < NUM_SECTORS; i++) {
+        where[i] = -1;
+    }
+    lock = new Lock("buffer cache lock");
+    numWaiting = 0;
+    released = new Semaphore("buffer cache released", 0);
+    numPending = 0;
+}
+
+BufferCache::~BufferCache()
+{
+    for (unsigned i = 0; i < numBuffers; i++) {
+        delete buffers[i].lock;
+        delete buffers[i].io;
+    }
+    delete [] buffers;
+    delete [] where;
+    delete released;
+    delete lock;
+}
+
+void
+BufferCache::Read(unsigned sector, char *into)
+{
+    ASSERT(into != nullptr);
+
+    Buffer *b = Acquire(sector, true);
+    memcpy(into, b->data, SECTOR_SIZE);
+    Release(b);
+}
+
+void
+BufferCache::Write(unsigned sector, const char *from)
+{
+    ASSERT(from != nullptr);
+
+    // The whole sector is overwritten, so there is no need to read it.
+    Buffer *b = Acquire(sector, false);
+    memcpy(b->data, from, SECTOR_SIZE);
+    b->dirty = true;
+    Release(b);
+}
+
+void
+BufferCache::Read(const DiskVector *vector, unsigned count)
+{
+    ASSERT(vector != nullptr);
+
+    DiskVector *missing = new DiskVector [count];
+    bool *cached = new bool [count];
+    unsigned numMissing = 0;
+    lock->Acquire();
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(vector[i].sector < NUM_SECTORS);
+        cached[i] = where[vector[i].sector] != -1;
+        if (!cached[i]) {
+            missing[numMissing++] = vector[i];
+        }
+    }
+    lock->Release();
+
+    // A single sector is not worth bypassing the cache for.
+    DiskRequest *request = nullptr;
+    if (numMissing > 1) {
+        request = new DiskRequest(missing, numMissing, false);
+        disk->Submit(request);
+        stats->numBufferCacheMisses += numMissing;
+    }
+    // Meanwhile, copy the rest.
+    for (unsigned i = 0; i < count; i++) {
+        if (cached[i] || request == nullptr) {
+            Read(vector[i].sector, vector[i].data);
+        }
+    }
+    if (request != nullptr) {
+        request->Wait();
+        delete request;
+    }
+    delete [] cached;
+    delete [] missing;
+}
+
+void
+BufferCache::Flush()
+{
+    // Take every dirty buffer first, and then write them all back.  Wait
+    // for those being written in the background, too.
+    Buffer **taken = new Buffer * [numBuffers];
+    DiskRequest **requests = new DiskRequest * [numBuffers];
+    unsigned count = 0;
+    for (unsigned i = 0; i < numBuffers; i++) {
+        Buffer *b = &buffers[i];
+        lock->Acquire();
+        if (!b->dirty && b->io == nullptr) {
+            lock->Release();
+            continue;
+        }
+        b->users++;
+        lock->Release();
+
+        b->lock->Acquire();
+        FinishIo(b);
+        if (!b->dirty) {
+            Release(b);
+            continue;
+        }
+        taken[count++] = b;
+    }
+
+    // Write runs of consecutive sectors together.
+    std::sort(taken, taken + count, [](const Buffer *a, const Buffer *b) {
+        return a->sector < b->sector;
+    });
+    DiskVector *vector = new DiskVector [count];
+    unsigned numRequests = 0;
+    for (unsigned i = 0, start = 0; i < count; i++) {
+        vector[i].sector = taken[i]->sector;
+        vector[i].data = taken[i]->data;
+        if (i + 1 == count || taken[i + 1]->sector != taken[i]->sector + 1) {
+            requests[numRequests++] = new DiskRequest(&vector[start],
+                                                      i + 1 - start, true);
+            start = i + 1;
+        }
+    }
+
+    disk->Submit(requests, numRequests);
+    for (unsigned i = 0; i < numRequests; i++) {
+        requests[i]->Wait();
+        delete requests[i];
+    }
+    for (unsigned i = 0; i < count; i++) {
+        taken[i]->dirty = false;
+        stats->numBufferCacheWritebacks++;
+        Release(taken[i]);
+    }
+    delete [] vector;
+    delete [] requests;
+    delete [] taken;
+}
+
+bool
+BufferCache::ReadAhead(unsigned sector)
+{
+    ASSERT(sector < NUM_SECTORS);
+
+    lock->Acquire();
+    if (where[sector] != -1) {
+        lock->Release();
+        return true;
+    }
+    // Do not let reads ahead take up more than half the buffers, nor wait
+    // for a buffer to be free or written back.  Dirty buffers found on the
+    // way are written back in the background, for later.
+    for (;;) {
+        int which = numPending < numBuffers / 2 ? PickVictim(true) : -1;
+        if (which == -1) {
+            lock->Release();
+            return false;
+        }
+        Buffer *b = &buffers[which];
+        if (b->dirty) {
+            DEBUG('f', "Writing back sector %d\n", b->sector);
+            b->io = new DiskRequest(b->sector, b->data, true, IoDone, this);
+            b->dirty = false;
+            stats->numBufferCacheWritebacks++;
+            disk->Submit(b->io);
+            continue;
+        }
+
+        DEBUG('f', "Reading sector %u ahead\n", sector);
+        Assign(which, sector);
+        b->readAhead = true;
+        b->io = new DiskRequest(sector, b->data, false, IoDone, this);
+        numPending++;
+        stats->numReadAheadSectors++;
+        disk->Submit(b->io);
+        lock->Release();
+        return true;
+    }
+}
+
+BufferCache::Buffer *
+BufferCache::Acquire(unsigned sector, bool fill)
+{
+    ASSERT(sector < NUM_SECTORS);
+
+    lock->Acquire();
+    for (;;) {
+        int which = where[sector];
+        if (which != -1) {
+            Buffer *b = &buffers[which];
+            b->users++;
+            Touch(which);
+            stats->numBufferCacheHits++;
+            if (b->readAhead) {
+                b->readAhead = false;
+                numPending--;
+                stats->numReadAheadHits++;
+            }
+            lock->Release();
+            // Whoever is filling the buffer holds its lock until done.
+            b->lock->Acquire();
+            FinishIo(b);
+            return b;
+        }
+
+        which = PickVictim();
+        if (which == -1) {
+            // Every buffer is in use.
+            numWaiting++;
+            lock->Release();
+            released->P();
+            lock->Acquire();
+            continue;
+        }
+        Buffer *b = &buffers[which];
+        if (b->dirty) {
+            // Write the old contents back first.  The buffer keeps its
+            // sector meanwhile, so that nobody reads a stale copy from
+            // disk; then look again, since anything may have changed.
+            b->users++;
+            lock->Release();
+            b->lock->Acquire();
+            if (b->dirty) {
+                DEBUG('f', "Writing back sector %d\n", b->sector);
+                disk->WriteToDisk(b->sector, b->data);
+                b->dirty = false;
+                stats->numBufferCacheWritebacks++;
+            }
+            Release(b);
+            lock->Acquire();
+            continue;
+        }
+
+        Assign(which, sector);
+        b->users++;
+        b->readAhead = false;
+        stats->numBufferCacheMisses++;
+        b->lock->Acquire();  // Free, since it had no users.
+        lock->Release();
+        if (fill) {
+            disk->ReadFromDisk(sector, b->data);
+        }
+        return b;
+    }
+}
+
+void
+BufferCache::Release(Buffer *b)
+{
+    ASSERT(b != nullptr);
+
+    b->lock->Release();
+    lock->Acquire();
+    b->users--;
+    if (b->users == 0) {
+        WakeWaiting();
+    }
+    lock->Release();
+}
+
+void
+BufferCache::WakeWaiting()
+{
+    // Also called by the interrupt handler, so keep it from running in
+    // between.
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (; numWaiting > 0; numWaiting--) {
+        released->V();
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+BufferCache::IoDone(void *cache_)
+{
+    BufferCache *cache = (BufferCache *) cache_;
+    cache->WakeWaiting();  // The buffer may be reused now.
+}
+
+int
+BufferCache::PickVictim(bool readAhead) const
+{
+    // Sectors read ahead are about to be used; take them only as a last
+    // resort, and never to read ahead some more.
+    int unused = -1;
+    for (int i = coldest; i != -1; i = buffers[i].warmer) {
+        const Buffer *b = &buffers[i];
+        if (b->users != 0 || (b->io != nullptr && !b->io->IsDone())) {
+            continue;
+        }
+        if (!b->readAhead) {
+            return i;
+        }
+        if (unused == -1 && !readAhead) {
+            unused = i;
+        }
+    }
+    return unused;
+}
+
+void
+BufferCache::FinishIo(Buffer *b)
+{
+    if (b->io != nullptr) {
+        b->io->Wait();
+        delete b->io;
+        b->io = nullptr;
+    }
+}
+
+void
+BufferCache::Assign(unsigned which, unsigned sector)
+{
+    Buffer *b = &buffers[which];
+    ASSERT(b->users == 0 && !b->dirty);
+
+    delete b->io;  // Finished, and never waited for.
+    b->io = nullptr;
+    if (b->readAhead) {
+        b->readAhead = false;
+        numPending--;
+    }
+    if (b->sector != -1) {
+        where[b->sector] = -1;
+    }
+    b->sector = sector;
+    where[sector] = which;
+    Touch(which);
+}
+
+void
+BufferCache::Touch(unsigned which)
+{
+    if ((int) which == warmest) {
+        return;
+    }
+    Buffer *b = &buffers[which];
+    if (b->colder != -1) {
+        buffers[b->colder].warmer = b->warmer;
+    } else {
+        coldest = b->warmer;
+    }
+    buffers[b->warmer].colder = b->colder;  // Not the warmest, so it has one.
+
+    b->colder = warmest;
+    b->warmer = -1;
+    buffers[warmest].warmer = which;
+    warmest = which;
+}
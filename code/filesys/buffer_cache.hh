@@ -0,0 +1,143 @@
+/// A cache of disk sectors in memory, in front of the synchronous disk.
+///
+/// Sectors read are kept in a fixed number of buffers, so that reading them
+/// again costs no disk request; metadata such as the free map and directory
+/// headers is read over and over.  Writes only modify the buffer, which is
+/// written back to disk when it is reused for another sector, or when the
+/// cache is flushed.  Buffers are reused in least recently used order.
+///
+/// Sectors can also be read ahead: a buffer is assigned to them and a read
+/// is submitted to the disk without waiting for it, so that whoever asked
+/// goes on.  The first thread to use the buffer waits for the read then.
+/// Dirty buffers in the way are written back in the background likewise.
+/// Flushing submits every write back at once, and then waits for all of
+/// them, so that the disk serves them in the order best for it.  Runs of
+/// consecutive sectors are written back in a single request each.
+///
+/// Each buffer has a lock of its own, held while its contents are being
+/// read, written or transferred, so that threads using different sectors
+/// do not wait for each other.  A lock over the whole cache only protects
+/// the mapping from sectors to buffers, and is never held during disk
+/// requests.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_BUFFERCACHE__HH
+#define NACHOS_FILESYS_BUFFERCACHE__HH
+
+
+#include "machine/disk.hh"
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
+
+
+class DiskRequest;
+class SynchDisk;
+
+/// Number of sector buffers unless told otherwise.
+const unsigned DEFAULT_NUM_BUFFERS = 64;
+
+class BufferCache {
+public:
+
+    /// Create `numBuffers` empty buffers, for sectors of `disk`.
+    BufferCache(SynchDisk *disk, unsigned numBuffers);
+
+    /// De-allocate the buffers.  Dirty ones are lost; see `Flush`.
+    ~BufferCache();
+
+    /// Copy sector `sector` into `into`, reading it from disk if it is not
+    /// in a buffer.
+    void Read(unsigned sector, char *into);
+
+    /// Copy `from` into the buffer for sector `sector`, which will be
+    /// written to disk later.
+    void Write(unsigned sector, const char *from);
+
+    /// Copy the `count` sectors in `vector` into their buffers.  If several
+    /// of them are not cached, read those from disk in one request, right
+    /// into place, and leave them uncached.
+    void Read(const DiskVector *vector, unsigned count);
+
+    /// Write every dirty buffer to disk.
+    void Flush();
+
+    /// Have sector `sector` read into a buffer in the background, unless
+    /// it is in one already.  Return false if too many sectors are being
+    /// read ahead already, or no buffer is free to read it into.
+    bool ReadAhead(unsigned sector);
+
+private:
+
+    struct Buffer {
+        int sector;      ///< Sector held, or -1.
+        bool dirty;      ///< Modified since read from or written to disk.
+        unsigned users;  ///< Threads holding or waiting for `lock`.
+        bool readAhead;  ///< Read ahead, and not used since.
+        DiskRequest *io;  ///< Read ahead or written back in the
+                          ///< background, and not waited for yet; or null.
+        Lock *lock;      ///< Held while the contents are used.
+        char data[SECTOR_SIZE];
+
+        /// Neighbours in the recency list, or -1.
+        int warmer;
+        int colder;
+    };
+
+    /// Return the buffer for sector `sector`, locked, taking the least
+    /// recently used one if the sector is not in any.  In that case, read
+    /// its contents from disk if `fill` is set.
+    Buffer *Acquire(unsigned sector, bool fill);
+
+    /// Unlock buffer `b`, taken with `Acquire`.
+    void Release(Buffer *b);
+
+    /// Return the least recently used buffer nobody is using, nor has a
+    /// transfer in progress, or -1.  If it is for `readAhead`, skip those
+    /// read ahead already but not used yet.
+    int PickVictim(bool readAhead = false) const;
+
+    /// Wait for the background transfer of buffer `b`, held, if any.
+    void FinishIo(Buffer *b);
+
+    /// Wake up every thread waiting for a buffer.
+    void WakeWaiting();
+
+    /// Called by the disk interrupt handler when a background transfer
+    /// completes.
+    static void IoDone(void *cache);
+
+    /// Make buffer `which`, which nobody is using, hold sector `sector`.
+    void Assign(unsigned which, unsigned sector);
+
+    /// Make buffer `which` the one used most recently.
+    void Touch(unsigned which);
+
+    SynchDisk *disk;
+
+    Buffer *buffers;
+    unsigned numBuffers;
+
+    /// Buffer holding each sector of the disk, or -1.
+    int *where;
+
+    /// Protects `where`, the users of every buffer and the recency list.
+    Lock *lock;
+
+    /// Threads waiting for some buffer to be left without users or
+    /// transfers, and the semaphore they wait on.
+    unsigned numWaiting;
+    Semaphore *released;
+
+    /// Ends of the recency list, linking every buffer.
+    int coldest;
+    int warmest;
+
+    /// Number of buffers read ahead and not used yet.
+    unsigned numPending;
+};
+
+
+#endif
@@ -2,11 +2,15 @@
 /// the i-node).
 ///
 /// The file header is used to locate where on disk the file's data is
-/// stored.  We implement this as a fixed size table of pointers -- each
-/// entry in the table points to the disk sector containing that portion of
-/// the file data (in other words, there are no indirect or doubly indirect
-/// blocks). The table size is chosen so that the file header will be just
-/// big enough to fit in one disk sector,
+/// stored.  We implement this as a fixed size table of extents -- each
+/// entry in the table points to a run of consecutive disk sectors containing
+/// that portion of the file data (in other words, there are no indirect or
+/// doubly indirect blocks). The table size is chosen so that the file header
+/// will be just big enough to fit in one disk sector,
+///
+/// Sectors are allocated in runs as long as possible, starting from the
+/// track of the file header, so that reading a file sequentially takes few
+/// seeks, and few disk requests.
 ///
 /// Unlike in a real system, we do not keep track of file permissions,
 /// ownership, last modification date, etc., in the file header.
@@ -34,25 +38,45 @@
 /// blocks for the file out of the map of free disk blocks.  Return false if
 /// there are not enough free blocks to accomodate the new file.
 ///
+/// The whole file goes in a single extent if there is room for it, looking
+/// from the start of the track of sector `near` on.  Otherwise it is split
+/// into the longest runs of free sectors there are.
+///
 /// * `freeMap` is the bit map of free disk sectors.
-/// * `fileSize` is the bit map of free disk sectors.
+/// * `fileSize` is the size of the file, in bytes.
+/// * `near` is the sector the file header goes in.
 bool
-FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
+FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize, unsigned near)
 {
     ASSERT(freeMap != nullptr);
+    ASSERT(near < NUM_SECTORS);
 
     if (fileSize > MAX_FILE_SIZE) {
         return false;
     }
 
     raw.numBytes = fileSize;
-    raw.numSectors = DivRoundUp(fileSize, SECTOR_SIZE);
-    if (freeMap->CountClear() < raw.numSectors) {
+    raw.numExtents = 0;
+    unsigned numSectors = DivRoundUp(fileSize, SECTOR_SIZE);
+    if (freeMap->CountClear() < numSectors) {
         return false;  // Not enough space.
     }
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        raw.dataSectors[i] = freeMap->Find();
+    unsigned from = near - near % SECTORS_PER_TRACK;
+    while (numSectors > 0) {
+        // No more extents than sectors are needed, so they fit.
+        ASSERT(raw.numExtents < NUM_EXTENTS);
+
+        unsigned length = numSectors;
+        int start = freeMap->FindRun(length, from);
+        if (start == -1) {
+            start = freeMap->FindLongestRun(&length, from);
+        }
+        ASSERT(start != -1 && length > 0);
+        raw.extents[raw.numExtents].start = start;
+        raw.extents[raw.numExtents].length = length;
+        raw.numExtents++;
+        numSectors -= length;
     }
     return true;
 }
@@ -65,9 +89,12 @@ FileHeader::Deallocate(Bitmap *freeMap)
 {
     ASSERT(freeMap != nullptr);
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        ASSERT(freeMap->Test(raw.dataSectors[i]));  // ought to be marked!
-        freeMap->Clear(raw.dataSectors[i]);
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        const Extent *e = &raw.extents[i];
+        for (unsigned j = 0; j < e->length; j++) {
+            ASSERT(freeMap->Test(e->start + j));  // ought to be marked!
+            freeMap->Clear(e->start + j);
+        }
     }
 }
 
@@ -98,7 +125,15 @@ FileHeader::WriteBack(unsigned sector)
 unsigned
 FileHeader::ByteToSector(unsigned offset)
 {
-    return raw.dataSectors[offset / SECTOR_SIZE];
+    unsigned block = offset / SECTOR_SIZE;
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        if (block < raw.extents[i].length) {
+            return raw.extents[i].start + block;
+        }
+        block -= raw.extents[i].length;
+    }
+    ASSERT(false);  // Past the end of the file.
+    return 0;
 }
 
 /// Return the number of bytes in the file.
@@ -122,17 +157,20 @@ FileHeader::Print(const char *title)
     }
 
     printf("    size: %u bytes\n"
-           "    block indexes: ",
+           "    extents: ",
            raw.numBytes);
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        printf("%u ", raw.dataSectors[i]);
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        printf("%u-%u ", raw.extents[i].start,
+               raw.extents[i].start + raw.extents[i].length - 1);
     }
     printf("\n");
 
-    for (unsigned i = 0, k = 0; i < raw.numSectors; i++) {
-        printf("    contents of block %u:\n", raw.dataSectors[i]);
-        synchDisk->ReadSector(raw.dataSectors[i], data);
+    unsigned numSectors = DivRoundUp(raw.numBytes, SECTOR_SIZE);
+    for (unsigned i = 0, k = 0; i < numSectors; i++) {
+        unsigned sector = ByteToSector(i * SECTOR_SIZE);
+        printf("    contents of block %u:\n", sector);
+        synchDisk->ReadSector(sector, data);
         for (unsigned j = 0; j < SECTOR_SIZE && k < raw.numBytes; j++, k++) {
             if (isprint(data[j])) {
                 printf("%c", data[j]);
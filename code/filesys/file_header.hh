@@ -19,8 +19,8 @@
 
 /// The following class defines the Nachos "file header" (in UNIX terms, the
 /// “i-node”), describing where on disk to find all of the data in the file.
-/// The file header is organized as a simple table of pointers to data
-/// blocks.
+/// The file header is organized as a table of extents: runs of consecutive
+/// data blocks.
 ///
 /// The file header data structure can be stored in memory or on disk.  When
 /// it is on disk, it is stored in a single sector -- this means that we
@@ -35,8 +35,8 @@ class FileHeader {
 public:
 
     /// Initialize a file header, including allocating space on disk for the
-    /// file data.
-    bool Allocate(Bitmap *bitMap, unsigned fileSize);
+    /// file data, as close to sector `near` as possible.
+    bool Allocate(Bitmap *bitMap, unsigned fileSize, unsigned near);
 
     /// De-allocate this file's data blocks.
     void Deallocate(Bitmap *bitMap);
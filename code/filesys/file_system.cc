@@ -46,6 +46,7 @@
 #include "directory.hh"
 #include "file_header.hh"
 #include "lib/bitmap.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
 #include <string.h>
@@ -69,6 +70,12 @@ static const unsigned DIRECTORY_SECTOR = 1;
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+
+    // The bitmap is written back whole words at a time, and has to fit in
+    // a single file.
+    ASSERT(NUM_SECTORS % BITS_IN_WORD == 0);
+    ASSERT(FREE_MAP_FILE_SIZE <= MAX_FILE_SIZE);
+
     if (format) {
         Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
         Directory  *dir     = new Directory(NUM_DIR_ENTRIES);
@@ -85,8 +92,9 @@ FileSystem::FileSystem(bool format)
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
 
-        ASSERT(mapH->Allocate(freeMap, FREE_MAP_FILE_SIZE));
-        ASSERT(dirH->Allocate(freeMap, DIRECTORY_FILE_SIZE));
+        ASSERT(mapH->Allocate(freeMap, FREE_MAP_FILE_SIZE, FREE_MAP_SECTOR));
+        ASSERT(dirH->Allocate(freeMap, DIRECTORY_FILE_SIZE,
+                              DIRECTORY_SECTOR));
 
         // Flush the bitmap and directory `FileHeader`s back to disk.
         // We need to do this before we can `Open` the file, since open reads
@@ -189,7 +197,7 @@ FileSystem::Create(const char *name, unsigned initialSize)
             success = false;  // No space in directory.
         } else {
             FileHeader *h = new FileHeader;
-            success = h->Allocate(freeMap, initialSize);
+            success = h->Allocate(freeMap, initialSize, sector);
               // Fails if no space on disk for data.
             if (success) {
                 // Everything worked, flush all changes back to disk.
@@ -263,6 +271,10 @@ FileSystem::Remove(const char *name)
     fileH->Deallocate(freeMap);  // Remove data blocks.
     freeMap->Clear(sector);      // Remove header block.
     dir->Remove(name);
+#ifdef VMEM
+    // The next file given this header sector is another one.
+    pageCache->Drop(FileId(sector, 0));
+#endif
 
     freeMap->WriteBack(freeMapFile);  // Flush to disk.
     dir->WriteBack(directoryFile);    // Flush to disk.
@@ -317,6 +329,20 @@ CheckSector(unsigned sector, Bitmap *shadowMap)
                          "sector number already used.");
 }
 
+/// Return the number of sectors in the extents of a file header, ignoring
+/// any past the table.
+static unsigned
+CountSectors(const RawFileHeader *rh)
+{
+    ASSERT(rh != nullptr);
+
+    unsigned numSectors = 0;
+    for (unsigned i = 0; i < rh->numExtents && i < NUM_EXTENTS; i++) {
+        numSectors += rh->extents[i].length;
+    }
+    return numSectors;
+}
+
 static bool
 CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
 {
@@ -324,16 +350,23 @@ CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
 
     bool error = false;
 
-    DEBUG('f', "Checking file header %u.  File size: %u bytes, number of sectors: %u.\n",
-          num, rh->numBytes, rh->numSectors);
-    error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
-                                                        SECTOR_SIZE),
+    DEBUG('f', "Checking file header %u.  File size: %u bytes, number of extents: %u.\n",
+          num, rh->numBytes, rh->numExtents);
+    if (CheckForError(rh->numExtents <= NUM_EXTENTS, "too many extents.")) {
+        return true;
+    }
+    unsigned numSectors = CountSectors(rh);
+    error |= CheckForError(numSectors >= DivRoundUp(rh->numBytes,
+                                                    SECTOR_SIZE),
                            "sector count not compatible with file size.");
-    error |= CheckForError(rh->numSectors < NUM_DIRECT,
+    error |= CheckForError(numSectors * SECTOR_SIZE <= MAX_FILE_SIZE,
                            "too many blocks.");
-    for (unsigned i = 0; i < rh->numSectors; i++) {
-        unsigned s = rh->dataSectors[i];
-        error |= CheckSector(s, shadowMap);
+    for (unsigned i = 0; i < rh->numExtents; i++) {
+        const Extent *e = &rh->extents[i];
+        error |= CheckForError(e->length > 0, "empty extent.");
+        for (unsigned j = 0; j < e->length; j++) {
+            error |= CheckSector(e->start + j, shadowMap);
+        }
     }
     return error;
 }
@@ -422,10 +455,11 @@ FileSystem::Check()
     DEBUG('f', "  File size: %u bytes, expected %u bytes.\n"
                "  Number of sectors: %u, expected %u.\n",
           bitRH->numBytes, FREE_MAP_FILE_SIZE,
-          bitRH->numSectors, FREE_MAP_FILE_SIZE / SECTOR_SIZE);
+          CountSectors(bitRH), DivRoundUp(FREE_MAP_FILE_SIZE, SECTOR_SIZE));
     error |= CheckForError(bitRH->numBytes == FREE_MAP_FILE_SIZE,
                            "bad bitmap header: wrong file size.");
-    error |= CheckForError(bitRH->numSectors == FREE_MAP_FILE_SIZE / SECTOR_SIZE,
+    error |= CheckForError(CountSectors(bitRH)
+                             == DivRoundUp(FREE_MAP_FILE_SIZE, SECTOR_SIZE),
                            "bad bitmap header: wrong number of sectors.");
     error |= CheckFileHeader(bitRH, FREE_MAP_SECTOR, shadowMap);
     delete bitH;
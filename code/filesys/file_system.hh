@@ -99,7 +99,9 @@ public:
 /// Initial file sizes for the bitmap and directory; until the file system
 /// supports extensible files, the directory size sets the maximum number of
 /// files that can be loaded onto the disk.
-static const unsigned FREE_MAP_FILE_SIZE = NUM_SECTORS / BITS_IN_BYTE;
+///
+/// The size of the bitmap follows the disk geometry chosen at startup.
+#define FREE_MAP_FILE_SIZE  (NUM_SECTORS / BITS_IN_BYTE)
 static const unsigned NUM_DIR_ENTRIES = 10;
 static const unsigned DIRECTORY_FILE_SIZE
   = sizeof (DirectoryEntry) * NUM_DIR_ENTRIES;
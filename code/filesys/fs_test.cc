@@ -7,8 +7,9 @@
 /// Print
 ///     Cat the contents of a Nachos file.
 /// Perftest
-///     A stress test for the Nachos file system read and write a really
-///     really large file in tiny chunks (will not work on baseline system!)
+///     A stress test for the Nachos file system: read and write a file as
+///     large as it can be in tiny chunks, read it from several threads at
+///     once, and create and remove files until free space is fragmented.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -17,6 +18,7 @@
 
 
 #include "file_system.hh"
+#include "raw_file_header.hh"
 #include "lib/utility.hh"
 #include "machine/disk.hh"
 #include "machine/statistics.hh"
@@ -104,17 +106,25 @@ Print(const char *name)
 ///
 /// Stress the Nachos file system by creating a large file, writing it out a
 /// bit at a time, reading it back a bit at a time, and then deleting the
-/// file.
+/// file.  Then create and remove files of different sizes, so that they end
+/// up split in several extents, and check the file system.
 ///
-/// Implemented as three separate routines:
+/// Implemented as separate routines:
 /// * `FileWrite` -- write the file.
 /// * `FileRead` -- read the file.
+/// * `ConcurrentRead` -- read the file from several threads, at scattered
+///   positions, so that the disk has several requests queued to choose
+///   from.
+/// * `Churn` -- create and remove files.
 /// * `PerformanceTest` -- overall control, and print out performance #'s.
+///
+/// Run it with `-cache 0` to see the disk scheduling policies at work.
 
 static const char FILE_NAME[] = "TestFile";
 static const char CONTENTS[] = "1234567890";
 static const unsigned CONTENT_SIZE = sizeof CONTENTS - 1;
-static const unsigned FILE_SIZE = CONTENT_SIZE * 5000;
+static const unsigned FILE_SIZE
+  = (MAX_FILE_SIZE - 1) / CONTENT_SIZE * CONTENT_SIZE;
 
 static void
 FileWrite()
@@ -122,7 +132,7 @@ FileWrite()
     printf("Sequential write of %u byte file, in %u byte chunks\n",
            FILE_SIZE, CONTENT_SIZE);
 
-    if (!fileSystem->Create(FILE_NAME, 0)) {
+    if (!fileSystem->Create(FILE_NAME, FILE_SIZE)) {
         fprintf(stderr, "Perf test: cannot create %s\n", FILE_NAME);
         return;
     }
@@ -169,6 +179,188 @@ FileRead()
     delete openFile;
 }
 
+static const unsigned NUM_READERS = 6;
+static const unsigned NUM_CHUNKS = FILE_SIZE / CONTENT_SIZE;
+
+/// Read every chunk of the file, in an order of its own: reader `n` starts
+/// at a different chunk, and strides over a different number of them.
+static void
+ScatteredRead(void *n_)
+{
+    unsigned n = *(unsigned *) n_;
+
+    OpenFile *openFile = fileSystem->Open(FILE_NAME);
+    if (openFile == nullptr) {
+        fprintf(stderr, "Perf test: unable to open file %s\n", FILE_NAME);
+        return;
+    }
+
+    // Strides of 37 and 61 chunks, both prime, visit every chunk, as long
+    // as `NUM_CHUNKS` is a multiple of neither.
+    unsigned stride = n % 2 == 0 ? 37 : 61;
+    unsigned chunk = n * NUM_CHUNKS / NUM_READERS;
+    char buffer[CONTENT_SIZE];
+    for (unsigned i = 0; i < NUM_CHUNKS; i++) {
+        int numBytes = openFile->ReadAt(buffer, CONTENT_SIZE,
+                                        chunk * CONTENT_SIZE);
+        if (numBytes < 10 || strncmp(buffer, CONTENTS, CONTENT_SIZE)) {
+            printf("Perf test: reader %u unable to read %s\n",
+                   n, FILE_NAME);
+            break;
+        }
+        chunk = (chunk + stride) % NUM_CHUNKS;
+    }
+
+    delete openFile;
+}
+
+static void
+ConcurrentRead()
+{
+    printf("Scattered read of %u byte file, in %u byte chunks,"
+           " by %u threads\n", FILE_SIZE, CONTENT_SIZE, NUM_READERS);
+
+    Thread *readers[NUM_READERS];
+    unsigned ids[NUM_READERS];
+    for (unsigned i = 0; i < NUM_READERS; i++) {
+        ids[i] = i;
+        readers[i] = new Thread("reader", true);
+        readers[i]->Fork(ScatteredRead, (void *) &ids[i]);
+    }
+    for (unsigned i = 0; i < NUM_READERS; i++) {
+        readers[i]->Join();
+    }
+}
+
+static const unsigned NUM_CHURN_FILES = 8;
+static const unsigned NUM_CHURN_ROUNDS = 6;
+
+/// Sectors kept aside for the bitmap, the directory and the file headers.
+static const unsigned CHURN_RESERVED_SECTORS = 16;
+
+/// Number of sectors of churned file `i` in round `round`.
+///
+/// Every file starts with the same number of sectors, as many as let all of
+/// them fit on the disk, up to 15.  Once created again, half of the files
+/// have twice as many minus two, and the other half just one, so a pair of
+/// them fits in the holes left by two of the former.  On a disk small
+/// enough that they fill most of it, for instance with `-tracks 3`, large
+/// files then have to be split in several extents.
+static unsigned
+ChurnSectors(unsigned i, unsigned round)
+{
+    unsigned sectors = (NUM_SECTORS - CHURN_RESERVED_SECTORS)
+                       / NUM_CHURN_FILES - 1;
+    if (sectors > 15) {
+        sectors = 15;
+    }
+    ASSERT(sectors >= 2);
+    if (round == 0) {
+        return sectors;
+    }
+    return i / 2 % 2 == 0 ? 2 * sectors - 2 : 1;
+}
+
+/// Size of churned file `i` in round `round`: a few bytes into its last
+/// sector, so that it is partially written.
+static unsigned
+ChurnSize(unsigned i, unsigned round)
+{
+    return (ChurnSectors(i, round) - 1) * SECTOR_SIZE + i * 3 + 1;
+}
+
+/// Byte `pos` of churned file `i`, written in round `round`.
+static char
+ChurnByte(unsigned i, unsigned round, unsigned pos)
+{
+    return 'a' + (i + round + pos / SECTOR_SIZE) % 26;
+}
+
+static bool
+ChurnWrite(const char *name, unsigned i, unsigned round)
+{
+    unsigned size = ChurnSize(i, round);
+    if (!fileSystem->Create(name, size)) {
+        fprintf(stderr, "Perf test: cannot create %s\n", name);
+        return false;
+    }
+    OpenFile *openFile = fileSystem->Open(name);
+    if (openFile == nullptr) {
+        fprintf(stderr, "Perf test: unable to open %s\n", name);
+        return false;
+    }
+    char *contents = new char [size];
+    for (unsigned pos = 0; pos < size; pos++) {
+        contents[pos] = ChurnByte(i, round, pos);
+    }
+    bool ok = openFile->WriteAt(contents, size, 0) == (int) size;
+    if (!ok) {
+        fprintf(stderr, "Perf test: unable to write %s\n", name);
+    }
+    delete [] contents;
+    delete openFile;
+    return ok;
+}
+
+static bool
+ChurnCheck(const char *name, unsigned i, unsigned round)
+{
+    unsigned size = ChurnSize(i, round);
+    OpenFile *openFile = fileSystem->Open(name);
+    if (openFile == nullptr) {
+        fprintf(stderr, "Perf test: unable to open %s\n", name);
+        return false;
+    }
+    char *contents = new char [size];
+    bool ok = openFile->Length() == size
+              && openFile->ReadAt(contents, size, 0) == (int) size;
+    for (unsigned pos = 0; ok && pos < size; pos++) {
+        ok = contents[pos] == ChurnByte(i, round, pos);
+    }
+    if (!ok) {
+        printf("Perf test: unable to read %s back\n", name);
+    }
+    delete [] contents;
+    delete openFile;
+    return ok;
+}
+
+/// Every round removes and creates again, with a new size, half of the
+/// files, alternating between the odd and the even ones, so that new files
+/// go into the holes left by the old ones; see `ChurnSectors`.
+static bool
+Churn()
+{
+    printf("Creating and removing %u files, %u times\n",
+           NUM_CHURN_FILES, NUM_CHURN_ROUNDS);
+
+    char names[NUM_CHURN_FILES][16];
+    unsigned rounds[NUM_CHURN_FILES];
+    bool ok = true;
+    for (unsigned i = 0; i < NUM_CHURN_FILES; i++) {
+        snprintf(names[i], sizeof names[i], "Churn%u", i);
+        rounds[i] = 0;
+        ok = ok && ChurnWrite(names[i], i, 0);
+    }
+    for (unsigned round = 1; ok && round < NUM_CHURN_ROUNDS; round++) {
+        for (unsigned i = round % 2; ok && i < NUM_CHURN_FILES; i += 2) {
+            ok = fileSystem->Remove(names[i]);
+            if (!ok) {
+                printf("Perf test: unable to remove %s\n", names[i]);
+            }
+            ok = ok && ChurnWrite(names[i], i, round);
+            rounds[i] = round;
+        }
+    }
+    for (unsigned i = 0; ok && i < NUM_CHURN_FILES; i++) {
+        ok = ChurnCheck(names[i], i, rounds[i]);
+    }
+    for (unsigned i = 0; i < NUM_CHURN_FILES; i++) {
+        fileSystem->Remove(names[i]);
+    }
+    return ok;
+}
+
 void
 PerformanceTest()
 {
@@ -176,9 +368,16 @@ PerformanceTest()
     stats->Print();
     FileWrite();
     FileRead();
+    ConcurrentRead();
     if (!fileSystem->Remove(FILE_NAME)) {
         printf("Perf test: unable to remove %s\n", FILE_NAME);
         return;
     }
+    if (!Churn()) {
+        return;
+    }
+    bool result = fileSystem->Check();
+    printf("Perf test: filesystem check %s.\n",
+           result ? "succeeded" : "failed");
     stats->Print();
 }
@@ -26,7 +26,11 @@ OpenFile::OpenFile(int sector)
 {
     hdr = new FileHeader;
     hdr->FetchFrom(sector);
+    hdrSector = sector;
     seekPosition = 0;
+    nextPosition = 0;
+    readAheadWindow = 0;
+    readAheadEnd = 0;
 }
 
 /// Close a Nachos file, de-allocating any in-memory data structures.
@@ -127,16 +131,16 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
     lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
     numSectors = 1 + lastSector - firstSector;
 
-    // Read in all the full and partial sectors that we need.
+    // Read in all the full and partial sectors that we need, at once.
     buf = new char [numSectors * SECTOR_SIZE];
-    for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->ReadSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                              &buf[(i - firstSector) * SECTOR_SIZE]);
-    }
+    ReadSectors(buf, firstSector, lastSector);
 
     // Copy the part we want.
     memcpy(into, &buf[position - firstSector * SECTOR_SIZE], numBytes);
     delete [] buf;
+
+    ReadAhead(position, lastSector);
+    nextPosition = position + numBytes;
     return numBytes;
 }
 
@@ -159,6 +163,9 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     }
     DEBUG('f', "Writing %u bytes at %u, from file of length %u.\n",
           numBytes, position, fileLength);
+#ifdef VMEM
+    pageCache->Drop(GetId());  // Code pages cached from it are stale now.
+#endif
 
     firstSector = DivRoundDown(position, SECTOR_SIZE);
     lastSector  = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
@@ -171,28 +178,89 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
 
     // Read in first and last sector, if they are to be partially modified.
     if (!firstAligned) {
-        ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+        ReadSectors(buf, firstSector, firstSector);
     }
     if (!lastAligned && (firstSector != lastSector || firstAligned)) {
-        ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
-               SECTOR_SIZE, lastSector * SECTOR_SIZE);
+        ReadSectors(&buf[(lastSector - firstSector) * SECTOR_SIZE],
+                    lastSector, lastSector);
     }
 
     // Copy in the bytes we want to change.
     memcpy(&buf[position - firstSector * SECTOR_SIZE], from, numBytes);
 
-    // Write modified sectors back.
+    // Write modified sectors back, at once.
+    DiskVector *vector = new DiskVector [numSectors];
     for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                               &buf[(i - firstSector) * SECTOR_SIZE]);
+        vector[i - firstSector].sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        vector[i - firstSector].data = &buf[(i - firstSector) * SECTOR_SIZE];
     }
+    synchDisk->WriteSectors(vector, numSectors);
+    delete [] vector;
     delete [] buf;
     return numBytes;
 }
 
+/// Sectors of the file are read whole, into consecutive sectors of `buf`,
+/// without affecting the position or the read-ahead state.
+void
+OpenFile::ReadSectors(char *buf, unsigned firstSector, unsigned lastSector)
+{
+    unsigned numSectors = 1 + lastSector - firstSector;
+    DiskVector *vector = new DiskVector [numSectors];
+    for (unsigned i = firstSector; i <= lastSector; i++) {
+        vector[i - firstSector].sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        vector[i - firstSector].data = &buf[(i - firstSector) * SECTOR_SIZE];
+    }
+    synchDisk->ReadSectors(vector, numSectors);
+    delete [] vector;
+}
+
+/// Sequential readers find the sectors they are about to need in the cache,
+/// read while they were busy with the previous ones.  The window doubles
+/// every time the reader gets halfway through what was read ahead, as long
+/// as it keeps reading sequentially.
+void
+OpenFile::ReadAhead(unsigned position, unsigned lastSector)
+{
+    if (position != nextPosition) {
+        readAheadWindow = 0;
+        readAheadEnd = lastSector + 1;
+        return;
+    }
+
+    if (readAheadWindow == 0) {
+        readAheadWindow = READ_AHEAD_INITIAL_WINDOW;
+    } else if (lastSector + readAheadWindow / 2 < readAheadEnd) {
+        return;
+    } else if (readAheadWindow < READ_AHEAD_MAX_WINDOW) {
+        readAheadWindow *= 2;
+    }
+    if (readAheadEnd <= lastSector) {
+        readAheadEnd = lastSector + 1;
+    }
+
+    unsigned numSectors = DivRoundUp(hdr->FileLength(), SECTOR_SIZE);
+    unsigned end = lastSector + 1 + readAheadWindow;
+    if (end > numSectors) {
+        end = numSectors;
+    }
+    for (; readAheadEnd < end; readAheadEnd++) {
+        unsigned sector = hdr->ByteToSector(readAheadEnd * SECTOR_SIZE);
+        if (!synchDisk->ReadAhead(sector)) {
+            break;  // Try again on the next read.
+        }
+    }
+}
+
 /// Return the number of bytes in the file.
 unsigned
 OpenFile::Length() const
 {
     return hdr->FileLength();
 }
+
+FileId
+OpenFile::GetId() const
+{
+    return FileId(hdrSector, 0);
+}
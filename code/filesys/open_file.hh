@@ -22,6 +22,14 @@
 
 #include "lib/utility.hh"
 
+#include <utility>
+
+
+/// What tells a file apart from every other file, while it exists, and
+/// from itself as it was before it was written, where writes can go
+/// unnoticed; see `OpenFile::GetId`.
+typedef std::pair<unsigned long, unsigned long> FileId;
+
 
 #ifdef FILESYS_STUB  // Temporarily implement calls to Nachos file system as
                      // calls to UNIX!  See definitions listed under `#else`.
@@ -79,6 +87,15 @@ public:
         return SystemDep::Tell(file);
     }
 
+    /// The inode number of the file, and the time it was last modified,
+    /// since it can be written to or replaced from outside Nachos.
+    FileId GetId() const
+    {
+        unsigned long inode, modified;
+        SystemDep::Identify(file, &inode, &modified);
+        return FileId(inode, modified);
+    }
+
 private:
     int file;
     unsigned currentOffset;
@@ -87,6 +104,11 @@ private:
 #else // FILESYS
 class FileHeader;
 
+/// Number of sectors read ahead once reads are found to be sequential, and
+/// the most the window grows to.
+const unsigned READ_AHEAD_INITIAL_WINDOW = 2;
+const unsigned READ_AHEAD_MAX_WINDOW = 16;
+
 class OpenFile {
 public:
 
@@ -114,10 +136,30 @@ public:
     // the UNIX idiom -- `lseek` to end of file, `tell`, `lseek` back).
     unsigned Length() const;
 
+    /// The sector of the file header, which no other file has while this
+    /// one exists.  Removing or writing the file drops it from the page
+    /// cache instead.
+    FileId GetId() const;
+
   private:
+    /// Read sectors `firstSector` to `lastSector` of the file into `buf`.
+    void ReadSectors(char *buf, unsigned firstSector, unsigned lastSector);
+
+    /// Having read up to sector `lastSector`, from `position`, read more
+    /// sectors ahead if reads have been sequential.
+    void ReadAhead(unsigned position, unsigned lastSector);
+
     FileHeader *hdr;  ///< Header for this file.
     unsigned seekPosition;  ///< Current position within the file.
-    int id;
+    unsigned hdrSector;  ///< Location of the file header on disk.
+
+    /// Where a read following the last one would start.
+    unsigned nextPosition;
+
+    /// Sectors to read ahead of the reader, 0 if reads are not sequential,
+    /// and the sector of the file following the last one read ahead.
+    unsigned readAheadWindow;
+    unsigned readAheadEnd;
 };
 
 #endif
@@ -9,16 +9,29 @@
 
 #include "machine/disk.hh"
 
+#include <stdint.h>
 
-static const unsigned NUM_DIRECT
-  = (SECTOR_SIZE - 2 * sizeof (int)) / sizeof (int);
-const unsigned MAX_FILE_SIZE = NUM_DIRECT * SECTOR_SIZE;
+
+/// A run of `length` consecutive sectors holding file data, from sector
+/// `start` on.  Sector numbers fit in 16 bits, since the free map has to
+/// fit in a file (cf. `FileSystem::FileSystem`).
+struct Extent {
+    uint16_t start;
+    uint16_t length;
+};
+
+static const unsigned NUM_EXTENTS
+  = (SECTOR_SIZE - 2 * sizeof (int)) / sizeof (Extent);
+
+/// Each extent may hold a single sector, if free space is scattered enough,
+/// so files are limited to what fits then.
+const unsigned MAX_FILE_SIZE = NUM_EXTENTS * SECTOR_SIZE;
 
 struct RawFileHeader {
     unsigned numBytes;  ///< Number of bytes in the file.
-    unsigned numSectors;  ///< Number of data sectors in the file.
-    unsigned dataSectors[NUM_DIRECT];  ///< Disk sector numbers for each data
-                                       ///< block in the file.
+    unsigned numExtents;  ///< Number of extents of data in the file.
+    Extent extents[NUM_EXTENTS];  ///< Where the data blocks of the file
+                                  ///< are on disk, in order.
 };
 
 
@@ -3,9 +3,11 @@
 /// happens later on).  This is a layer on top of the disk providing a
 /// synchronous interface (requests wait until the request completes).
 ///
-/// Use a semaphore to synchronize the interrupt handlers with the pending
-/// requests.  And, because the physical disk can only handle one operation
-/// at a time, use a lock to enforce mutual exclusion.
+/// Requests wait in a queue, since the physical disk can only handle one
+/// operation at a time.  Each request has a semaphore of its own, which the
+/// interrupt handler signals when that request completes, before sending
+/// the next one to the disk.  The queue is shared with the interrupt
+/// handler, so it is only touched with interrupts off.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -14,8 +16,74 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
 
 
+const char *DISK_POLICY_NAMES[NUM_DISK_POLICIES] = {
+    "fifo", "scan", "clook", "deadline"
+};
+
+DiskRequest::DiskRequest(unsigned sector_, char *data_, bool writing_,
+                         VoidFunctionPtr callback_, void *callbackArg_)
+{
+    ASSERT(sector_ < NUM_SECTORS);
+    ASSERT(data_ != nullptr);
+
+    single.sector = sector_;
+    single.data = data_;
+    vector = &single;
+    count = 1;
+    writing = writing_;
+    callback = callback_;
+    callbackArg = callbackArg_;
+    done = false;
+    queued = started = 0;
+    finished = new Semaphore("disk request", 0);
+}
+
+DiskRequest::DiskRequest(const DiskVector *vector_, unsigned count_,
+                         bool writing_, VoidFunctionPtr callback_,
+                         void *callbackArg_)
+{
+    ASSERT(vector_ != nullptr);
+    ASSERT(count_ > 0);
+
+    vector = new DiskVector [count_];
+    for (unsigned i = 0; i < count_; i++) {
+        ASSERT(vector_[i].sector < NUM_SECTORS);
+        ASSERT(vector_[i].data != nullptr);
+        vector[i] = vector_[i];
+    }
+    count = count_;
+    writing = writing_;
+    callback = callback_;
+    callbackArg = callbackArg_;
+    done = false;
+    queued = started = 0;
+    finished = new Semaphore("disk request", 0);
+}
+
+DiskRequest::~DiskRequest()
+{
+    if (vector != &single) {
+        delete [] vector;
+    }
+    delete finished;
+}
+
+bool
+DiskRequest::IsDone() const
+{
+    return done;
+}
+
+void
+DiskRequest::Wait()
+{
+    finished->P();
+    finished->V();  // Let anybody else waiting through, too.
+}
+
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
 /// handle pointers to member functions.
 static void
@@ -31,19 +99,26 @@ DiskRequestDone(void *arg)
 ///
 /// * `name` is a UNIX file name to be used as storage for the disk data
 ///   (usually, `DISK`).
-SynchDisk::SynchDisk(const char *name)
+/// * `numBuffers` is the number of sectors to cache, or zero.
+/// * `policy` is the order in which queued requests are served.
+SynchDisk::SynchDisk(const char *name, unsigned numBuffers, DiskPolicy policy_)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    ASSERT(0 <= policy_ && policy_ < NUM_DISK_POLICIES);
+
     disk = new Disk(name, DiskRequestDone, this);
+    policy = policy_;
+    current = nullptr;
+    head = 0;
+    goingUp = true;
+    stats->diskPolicy = DISK_POLICY_NAMES[policy];
+    cache = numBuffers > 0 ? new BufferCache(this, numBuffers) : nullptr;
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
 SynchDisk::~SynchDisk()
 {
+    delete cache;
     delete disk;
-    delete lock;
-    delete semaphore;
 }
 
 /// Read the contents of a disk sector into a buffer.  Return only after the
@@ -54,34 +129,226 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char *data)
 {
-    ASSERT(data != nullptr);
-
-    lock->Acquire();  // Only one disk I/O at a time.
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();   // Wait for interrupt.
-    lock->Release();
+    if (cache != nullptr) {
+        cache->Read(sectorNumber, data);
+    } else {
+        ReadFromDisk(sectorNumber, data);
+    }
 }
 
-/// Write the contents of a buffer into a disk sector.  Return only
-/// after the data has been written.
+/// Write the contents of a buffer into a disk sector.  Return only after
+/// the data has been written, to the cache if there is one.
 ///
 /// * `sectorNumber` is the disk sector to be written.
 /// * `data` are the new contents of the disk sector.
 void
 SynchDisk::WriteSector(int sectorNumber, const char *data)
 {
-    ASSERT(data != nullptr);
+    if (cache != nullptr) {
+        cache->Write(sectorNumber, data);
+    } else {
+        WriteToDisk(sectorNumber, data);
+    }
+}
+
+/// Read/write the sectors in `vector`.  Without a cache, all of them go in
+/// one request.  With one, reads of sectors not in it still do, but writes
+/// only reach the disk when written back; see `BufferCache::Flush`.
+///
+/// * `vector` lists the sectors, and the buffer for each.
+/// * `count` is the number of sectors.
+void
+SynchDisk::ReadSectors(const DiskVector *vector, unsigned count)
+{
+    if (cache != nullptr) {
+        cache->Read(vector, count);
+    } else {
+        DiskRequest request(vector, count, false);
+        Submit(&request);
+        request.Wait();
+    }
+}
+
+void
+SynchDisk::WriteSectors(const DiskVector *vector, unsigned count)
+{
+    ASSERT(vector != nullptr);
+
+    if (cache != nullptr) {
+        for (unsigned i = 0; i < count; i++) {
+            cache->Write(vector[i].sector, vector[i].data);
+        }
+    } else {
+        DiskRequest request(vector, count, true);
+        Submit(&request);
+        request.Wait();
+    }
+}
+
+void
+SynchDisk::Flush()
+{
+    if (cache != nullptr) {
+        cache->Flush();
+    }
+}
+
+bool
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    return cache != nullptr && cache->ReadAhead(sectorNumber);
+}
+
+void
+SynchDisk::ReadFromDisk(int sectorNumber, char *data)
+{
+    DiskRequest request(sectorNumber, data, false);
+    Submit(&request);
+    request.Wait();
+}
+
+void
+SynchDisk::WriteToDisk(int sectorNumber, const char *data)
+{
+    DiskRequest request(sectorNumber, (char *) data, true);
+    Submit(&request);
+    request.Wait();
+}
+
+void
+SynchDisk::Submit(DiskRequest *request)
+{
+    Submit(&request, 1);
+}
+
+void
+SynchDisk::Submit(DiskRequest **requests, unsigned count)
+{
+    ASSERT(requests != nullptr);
 
-    lock->Acquire();  // only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();   // wait for interrupt
-    lock->Release();
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(requests[i] != nullptr && !requests[i]->done);
+        requests[i]->queued = stats->totalTicks;
+        queue.push_back(requests[i]);
+    }
+    // Choose only once all of them are in the queue.
+    if (current == nullptr && !queue.empty()) {
+        Start(PickNext());
+    }
+    interrupt->SetLevel(oldLevel);
 }
 
-/// Disk interrupt handler.  Wake up any thread waiting for the disk
-/// request to finish.
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    ASSERT(request != nullptr);
+    ASSERT(current == nullptr);
+
+    unsigned long wait = stats->totalTicks - request->queued;
+    stats->diskQueueTicks += wait;
+    if (wait > stats->maxDiskQueueTicks) {
+        stats->maxDiskQueueTicks = wait;
+    }
+    for (unsigned i = 0; i < request->count; i++) {
+        unsigned from = head / SECTORS_PER_TRACK;
+        unsigned to = request->vector[i].sector / SECTORS_PER_TRACK;
+        stats->diskSeekTracks += to > from ? to - from : from - to;
+        head = request->vector[i].sector;
+    }
+
+    current = request;
+    request->started = stats->totalTicks;
+    if (request->writing) {
+        disk->WriteRequest(request->vector, request->count);
+    } else {
+        disk->ReadRequest(request->vector, request->count);
+    }
+}
+
+int
+SynchDisk::Nearest(bool up) const
+{
+    int nearest = -1;
+    for (unsigned i = 0; i < queue.size(); i++) {
+        unsigned sector = queue[i]->vector[0].sector;
+        if (up ? sector < head : sector > head) {
+            continue;
+        }
+        if (nearest == -1
+              || (up ? sector < queue[nearest]->vector[0].sector
+                     : sector > queue[nearest]->vector[0].sector)) {
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+DiskRequest *
+SynchDisk::PickNext()
+{
+    ASSERT(!queue.empty());
+
+    int next = 0;
+    switch (policy) {
+        case DISK_FIFO:
+            break;
+
+        case DISK_SCAN:
+            next = Nearest(goingUp);
+            if (next == -1) {
+                goingUp = !goingUp;
+                next = Nearest(goingUp);
+            }
+            break;
+
+        case DISK_DEADLINE:
+            // The oldest request is the first one.
+            if (stats->totalTicks - queue[0]->queued > DISK_DEADLINE_TICKS) {
+                stats->numDiskDeadlinesMissed++;
+                break;
+            }
+            // Otherwise, as C-LOOK.
+            // Fall through.
+        case DISK_CLOOK:
+            next = Nearest(true);
+            if (next == -1) {  // Jump back to the lowest request.
+                next = 0;
+                for (unsigned i = 1; i < queue.size(); i++) {
+                    if (queue[i]->vector[0].sector
+                          < queue[next]->vector[0].sector) {
+                        next = i;
+                    }
+                }
+            }
+            break;
+
+        default:
+            ASSERT(false);
+    }
+
+    ASSERT(next != -1);
+    DiskRequest *request = queue[next];
+    queue.erase(queue.begin() + next);
+    return request;
+}
+
+/// Disk interrupt handler.  Wake up the thread waiting for the request
+/// that finished, and send the next one to the disk.
 void
 SynchDisk::RequestDone()
 {
-    semaphore->V();
+    ASSERT(current != nullptr);
+
+    DiskRequest *request = current;
+    stats->diskServiceTicks += stats->totalTicks - request->started;
+    current = nullptr;
+    if (!queue.empty()) {
+        Start(PickNext());
+    }
+    request->done = true;
+    if (request->callback != nullptr) {
+        request->callback(request->callbackArg);
+    }
+    request->finished->V();
 }
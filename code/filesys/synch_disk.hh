@@ -9,10 +9,80 @@
 #define NACHOS_FILESYS_SYNCHDISK__HH
 
 
+#include "buffer_cache.hh"
 #include "machine/disk.hh"
-#include "threads/lock.hh"
 #include "threads/semaphore.hh"
 
+#include <vector>
+
+
+/// Orders in which queued requests are sent to the disk.
+enum DiskPolicy {
+    DISK_FIFO,      ///< The order they were made in.
+    DISK_SCAN,      ///< Elevator: sweep up and down, serving requests on
+                    ///< the way.
+    DISK_CLOOK,     ///< Sweep up only, then jump back to the lowest request.
+    DISK_DEADLINE,  ///< C-LOOK, but requests waiting for too long go first.
+    NUM_DISK_POLICIES
+};
+
+extern const char *DISK_POLICY_NAMES[NUM_DISK_POLICIES];
+
+/// Policy used unless another one is asked for on the command line.
+const DiskPolicy DEFAULT_DISK_POLICY = DISK_DEADLINE;
+
+/// Ticks a request can wait under `DISK_DEADLINE` before it is served
+/// ahead of the sweep; a few full strokes of the head.
+const unsigned long DISK_DEADLINE_TICKS = 100000;
+
+
+/// A read or write of one sector, or of a list of them, to be submitted with
+/// `SynchDisk::Submit` and completed later.
+///
+/// Requests belong to whoever creates them, and must be kept around until
+/// they complete.  Completion can be waited for on the request, or noticed
+/// through a callback, which is run by the disk interrupt handler and so
+/// must not block.
+class DiskRequest {
+public:
+
+    /// Set up a request to read sector `sector` into `data`, or to write
+    /// it from `data` if `writing` is set.  `callback`, if not null, is
+    /// called with `callbackArg` once the request completes.
+    DiskRequest(unsigned sector, char *data, bool writing,
+                VoidFunctionPtr callback = nullptr,
+                void *callbackArg = nullptr);
+
+    /// Likewise, for the `count` sectors in `vector`, which is copied.
+    DiskRequest(const DiskVector *vector, unsigned count, bool writing,
+                VoidFunctionPtr callback = nullptr,
+                void *callbackArg = nullptr);
+
+    ~DiskRequest();
+
+    /// Return whether the request has completed.
+    bool IsDone() const;
+
+    /// Wait until the request completes.  Any number of threads can wait
+    /// for the same request, and it can be waited for again.
+    void Wait();
+
+private:
+    friend class SynchDisk;
+
+    DiskVector *vector;
+    unsigned count;
+    DiskVector single;  ///< The vector, for requests of one sector.
+    bool writing;
+    VoidFunctionPtr callback;
+    void *callbackArg;
+
+    bool done;
+    unsigned long queued;   ///< When it was submitted.
+    unsigned long started;  ///< When it was sent to the disk.
+    Semaphore *finished;    ///< Signalled when it completes.
+};
+
 
 /// The following class defines a "synchronous" disk abstraction.
 ///
@@ -24,11 +94,21 @@
 ///
 /// This class provides the abstraction that for any individual thread making
 /// a request, it waits around until the operation finishes before returning.
+/// Requests from many threads can be outstanding at once: they are queued,
+/// and sent to the disk one at a time in the order set by a `DiskPolicy`.
+/// Requests can also be submitted without waiting for them, one at a time
+/// or in batches, so that a thread goes on while the disk works.
+///
+/// Sectors go through a buffer cache, if there is one; see
+/// `buffer_cache.hh`.
 class SynchDisk {
 public:
 
-    /// Initialize a synchronous disk, by initializing the raw Disk.
-    SynchDisk(const char *name);
+    /// Initialize a synchronous disk, by initializing the raw Disk, with a
+    /// cache of `numBuffers` sectors in front of it, no cache if zero, and
+    /// serving requests according to `policy`.
+    SynchDisk(const char *name, unsigned numBuffers = 0,
+              DiskPolicy policy = DEFAULT_DISK_POLICY);
 
     /// De-allocate the synch disk data.
     ~SynchDisk();
@@ -40,16 +120,66 @@ public:
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Likewise, for the `count` sectors in `vector`.  Sectors that have to
+    /// come from the disk are transferred together, in as few requests as
+    /// possible.
+
+    void ReadSectors(const DiskVector *vector, unsigned count);
+    void WriteSectors(const DiskVector *vector, unsigned count);
+
+    /// Write every sector modified in the cache to the disk.
+    void Flush();
+
+    /// Start reading a sector into the cache, without waiting for it.
+    /// Return false if it cannot be done now, or at all without a cache.
+    bool ReadAhead(int sectorNumber);
+
+    /// Queue `request` for the disk, and return without waiting for it.
+    /// It goes to the disk itself, bypassing the cache, so it is meant for
+    /// the cache itself, or for sectors never accessed through it.
+    void Submit(DiskRequest *request);
+
+    /// Queue the `count` requests in `requests` at once, so that they are
+    /// served in the order best for the disk.
+    void Submit(DiskRequest **requests, unsigned count);
+
     /// Called by the disk device interrupt handler, to signal that the
     /// current disk operation is complete.
     void RequestDone();
 
 private:
+    friend class BufferCache;
+
+    /// Read/write a sector on the disk itself, bypassing the cache.
+
+    void ReadFromDisk(int sectorNumber, char *data);
+    void WriteToDisk(int sectorNumber, const char *data);
+
+    /// Send `request` to the disk.  Called with interrupts off.
+    void Start(DiskRequest *request);
+
+    /// Take the next request to start out of the queue, which must not be
+    /// empty.
+    DiskRequest *PickNext();
+
+    /// Return the index in the queue of the request closest to the head
+    /// going up, or down, from it; or -1 if there is none.
+    int Nearest(bool up) const;
+
     Disk *disk;  ///< Raw disk device.
-    Semaphore *semaphore;  ///< To synchronize requesting thread with the
-                           ///< interrupt handler.
-    Lock *lock;  ///< Only one read/write request can be sent to the disk at
-                 ///< a time.
+    BufferCache *cache;  ///< Recently used sectors, or null.
+
+    DiskPolicy policy;
+
+    /// Requests not yet sent to the disk, oldest first, and the one being
+    /// served, if any.  Only one can be sent to the disk at a time.
+    std::vector<DiskRequest *> queue;
+    DiskRequest *current;
+
+    /// Last sector of the last request started, where the head is, and
+    /// whether the head is sweeping up, for `DISK_SCAN`.
+    unsigned head;
+    bool goingUp;
 };
 
 
@@ -80,6 +80,75 @@ Bitmap::Find()
     return -1;
 }
 
+/// Return the first bit of `length` clear ones in a row, looking from bit
+/// `from` on and wrapping around.  As a side effect, set them.
+///
+/// If there is no such run, return -1.
+int
+Bitmap::FindRun(unsigned length, unsigned from)
+{
+    ASSERT(length > 0);
+    ASSERT(from < numBits);
+
+    for (unsigned k = 0; k < numBits; k++) {
+        unsigned start = (from + k) % numBits;
+        if (start + length > numBits) {
+            continue;
+        }
+        unsigned i = 0;
+        while (i < length && !Test(start + i)) {
+            i++;
+        }
+        if (i == length) {
+            for (i = 0; i < length; i++) {
+                Mark(start + i);
+            }
+            return start;
+        }
+    }
+    return -1;
+}
+
+/// Return the first bit of the longest run of clear ones; among runs as
+/// long, the first one from bit `from` on, wrapping around.  As a side
+/// effect, set them, and store how many they are in `*length`.
+///
+/// If no bits are clear, return -1.
+int
+Bitmap::FindLongestRun(unsigned *length, unsigned from)
+{
+    ASSERT(length != nullptr);
+    ASSERT(from < numBits);
+
+    int best = -1;
+    unsigned bestLength = 0;
+    unsigned bestDistance = 0;
+    for (unsigned i = 0; i < numBits; ) {
+        if (Test(i)) {
+            i++;
+            continue;
+        }
+        unsigned start = i;
+        while (i < numBits && !Test(i)) {
+            i++;
+        }
+        unsigned runLength = i - start;
+        unsigned distance = (start + numBits - from) % numBits;
+        if (runLength > bestLength
+              || (runLength == bestLength && distance < bestDistance)) {
+            best = start;
+            bestLength = runLength;
+            bestDistance = distance;
+        }
+    }
+
+    for (unsigned i = 0; i < bestLength; i++) {
+        Mark(best + i);
+    }
+    *length = bestLength;
+    return best;
+}
+
 /// Return the number of clear bits in the bitmap.  (In other words, how many
 /// bits are unallocated?)
 unsigned
@@ -55,6 +55,19 @@ public:
     /// If no bits are clear, return -1.
     int Find();
 
+    /// Return the index of the first of `length` clear bits in a row,
+    /// looking from bit `from` on and then wrapping around, and set them.
+    ///
+    /// If there are not so many clear bits in a row, return -1.
+    int FindRun(unsigned length, unsigned from = 0);
+
+    /// Return the index of the first of the longest run of clear bits, the
+    /// first one from bit `from` on among those as long, and set them.
+    /// Store its length in `*length`.
+    ///
+    /// If no bits are clear, return -1.
+    int FindLongestRun(unsigned *length, unsigned from = 0);
+
     /// Return the number of clear bits.
     unsigned CountClear() const;
 
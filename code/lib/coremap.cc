@@ -8,11 +8,18 @@
 
 
 #include "coremap.hh"
+#include "replacement_policy.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
 #include<cstdlib>
 
 
+const char *PAGE_POLICY_NAMES[NUM_PAGE_POLICIES] = {
+    "random", "fifo", "clock", "aging", "wsclock", "opt"
+};
+
+
 /// Initialize a Coremap with `nitems` bits, so that every bit is clear.  It
 /// can be added somewhere on a list.
 ///
@@ -22,26 +29,69 @@ Coremap::Coremap(unsigned nitems)
     ASSERT(nitems > 0);
 
     numEntrys  = nitems;
-    #ifdef FIFO
-        fifo = new std::list<unsigned int>;
-    #endif
-    #ifdef PRPOLICY_CLOCK
-        needle = 0;
-    #endif
-    // numEntrys = DivRoundUp(numEntrys, BITS_IN_WORD);
-    map = new InfoCore [numEntrys];
+    owners   = new Thread * [numEntrys];
+    vpns     = new int [numEntrys];
+    refs     = new unsigned [numEntrys];
+    flags    = new unsigned char [numEntrys];
+    nextFree = new int [numEntrys];
+    prevFree = new int [numEntrys];
+    policy = nullptr;
+    trace = nullptr;
+    // Lowest frames first, as the linear search used to hand them out.
     for (unsigned i = 0; i < numEntrys; i++) {
-        Clear(i);
+        owners[i] = nullptr;
+        vpns[i] = -1;
+        refs[i] = 0;
+        flags[i] = 0;
+        prevFree[i] = (int) i - 1;
+        nextFree[i] = i + 1 < numEntrys ? (int) i + 1 : -1;
     }
+    freeHead = 0;
+    numFree = numEntrys;
+    numPinned = numWaiting = 0;
+    unpinned = new Semaphore("unpinned", 0);
+    SetPolicy(DEFAULT_PAGE_POLICY);
 }
 
 /// De-allocate a Coremap.
 Coremap::~Coremap()
 {
-    #ifdef FIFO
-        delete fifo;
-    #endif
-    delete [] map;
+    if (trace != nullptr) {
+        fclose(trace);
+    }
+    delete policy;
+    delete [] owners;
+    delete [] vpns;
+    delete [] refs;
+    delete [] flags;
+    delete [] nextFree;
+    delete [] prevFree;
+    delete unpinned;
+}
+
+void
+Coremap::SetPolicy(PagePolicy kind, const char *traceFile)
+{
+    ASSERT(0 <= kind && kind < NUM_PAGE_POLICIES);
+
+    delete policy;
+    policy = NewReplacementPolicy(kind, this,
+                                  kind == PAGE_OPTIMAL ? traceFile : nullptr);
+    for (unsigned i = 0; i < numEntrys; i++) {
+        if (Test(i)) {
+            policy->Loaded(i);
+        }
+    }
+
+    if (trace != nullptr) {
+        fclose(trace);
+        trace = nullptr;
+    }
+    if (traceFile != nullptr && kind != PAGE_OPTIMAL) {
+        trace = fopen(traceFile, "w");
+        ASSERT(trace != nullptr);
+    }
+    stats->pagePolicy = PAGE_POLICY_NAMES[kind];
 }
 
 /// Set the “nth” bit in a Coremap.
@@ -50,13 +100,18 @@ Coremap::~Coremap()
 void
 Coremap::Mark(unsigned which, int vpn, Thread *thread)
 {
-    #ifdef FIFO
-        fifo->push_front(which);
-    #endif
     ASSERT(which < numEntrys);
-    map[which].busy = true;
-    map[which].vpn = vpn;
-    map[which].thread = thread;
+    if (!Test(which)) {
+        Unlink(which);
+    }
+    flags[which] = FRAME_BUSY;
+    vpns[which] = vpn;
+    owners[which] = thread;
+    refs[which] = 1;
+    policy->Loaded(which);
+    // The frame is about to be filled with a different page, so whatever
+    // instructions were decoded from it are stale.
+    machine->GetMMU()->InvalidateFrame(which);
 }
 
 /// Clear the “nth” bit in a Coremap.
@@ -65,13 +120,38 @@ Coremap::Mark(unsigned which, int vpn, Thread *thread)
 void
 Coremap::Clear(unsigned which)
 {
-    #ifdef FIFO
-        fifo->remove(which);
-    #endif
     ASSERT(which < numEntrys);
-    map[which].busy = false;
-    map[which].thread = nullptr;
-    map[which].vpn = -1;
+    if (!Test(which)) {
+        return;
+    }
+    ASSERT(!IsPinned(which));
+    flags[which] = 0;
+    owners[which] = nullptr;
+    vpns[which] = -1;
+    refs[which] = 0;
+    policy->Freed(which);
+
+    prevFree[which] = -1;
+    nextFree[which] = freeHead;
+    if (freeHead != -1) {
+        prevFree[freeHead] = which;
+    }
+    freeHead = which;
+    numFree++;
+}
+
+void
+Coremap::Unlink(unsigned which)
+{
+    if (prevFree[which] != -1) {
+        nextFree[prevFree[which]] = nextFree[which];
+    } else {
+        freeHead = nextFree[which];
+    }
+    if (nextFree[which] != -1) {
+        prevFree[nextFree[which]] = prevFree[which];
+    }
+    numFree--;
 }
 
 /// Return true if the “nth” bit is set.
@@ -81,23 +161,22 @@ bool
 Coremap::Test(unsigned which) const
 {
     ASSERT(which < numEntrys);
-    return map[which].busy == true;
+    return flags[which] & FRAME_BUSY;
 }
 
-/// Return the number of the first bit which is clear.  As a side effect, set
-/// the bit (mark it as in use).  (In other words, find and allocate a bit.)
+/// Return the number of a bit which is clear, the one at the head of the free
+/// list.  As a side effect, set the bit (mark it as in use).  (In other words,
+/// find and allocate a bit.)
 ///
 /// If no bits are clear, return -1.
 int
 Coremap::Find(int vpn, Thread *thread)
 {
-    for (unsigned i = 0; i < numEntrys; i++) {
-        if (!Test(i)) {
-            Mark(i, vpn, thread);
-            return i;
-        }
+    int which = freeHead;
+    if (which != -1) {
+        Mark(which, vpn, thread);
     }
-    return -1;
+    return which;
 }
 
 /// Return the number of clear bits in the Coremap.  (In other words, how many
@@ -105,14 +184,7 @@ Coremap::Find(int vpn, Thread *thread)
 unsigned
 Coremap::CountClear() const
 {
-    unsigned count = 0;
-
-    for (unsigned i = 0; i < numEntrys; i++) {
-        if (!Test(i)) {
-            count++;
-        }
-    }
-    return count;
+    return numFree;
 }
 
 /// Print the contents of the Coremap, for debugging.
@@ -131,57 +203,182 @@ Coremap::Print() const
     printf("\n");
 }
 
+void
+Coremap::Share(unsigned which, Thread *thread)
+{
+    ASSERT(Test(which));
+    ASSERT(thread != nullptr && thread->space != nullptr);
+
+    thread->space->SetNextSharer(vpns[which], owners[which]);
+    owners[which] = thread;
+    refs[which]++;
+}
+
+void
+Coremap::Unmap(unsigned which, Thread *thread)
+{
+    ASSERT(Test(which));
+    ASSERT(refs[which] > 0);
+
+    unsigned vpn = vpns[which];
+    if (owners[which] == thread) {
+        owners[which] = thread->space->GetNextSharer(vpn);
+    } else {
+        Thread *t = owners[which];
+        while (t->space->GetNextSharer(vpn) != thread) {
+            t = t->space->GetNextSharer(vpn);
+            ASSERT(t != nullptr);
+        }
+        t->space->SetNextSharer(vpn, thread->space->GetNextSharer(vpn));
+    }
+    thread->space->SetNextSharer(vpn, nullptr);
+    refs[which]--;
+    if (refs[which] == 0 && !IsCached(which)) {
+        Clear(which);
+    }
+}
+
+unsigned
+Coremap::GetRefs(unsigned which) const
+{
+    ASSERT(which < numEntrys);
+    return refs[which];
+}
+
+void
+Coremap::SetCached(unsigned which)
+{
+    ASSERT(Test(which));
+    flags[which] |= FRAME_CACHED;
+}
+
+bool
+Coremap::IsCached(unsigned which) const
+{
+    ASSERT(which < numEntrys);
+    return flags[which] & FRAME_CACHED;
+}
+
 Thread *
 Coremap::GetThread(unsigned which) {
-    return map[which].thread;
+    ASSERT(which < numEntrys);
+    return owners[which];
 }
 
 int
 Coremap::GetVPN(unsigned which) {
-    return map[which].vpn;
+    ASSERT(which < numEntrys);
+    return vpns[which];
 }
 
-int
-Coremap::PickVictim() {
-    #ifdef FIFO
-        return fifo->back();
-    #endif
-    #ifdef PRPOLICY_CLOCK
-        // Find (0,0)
-        int index;
-        Thread *thread;
-        int vpn;
-        for(int i = 0; i < numEntrys; i++) {
-            index = (needle + i) % numEntrys;
-            thread = map[index].thread;
-            vpn = map[index].vpn;
-            if(!thread->space->GetUse(vpn) && !thread->space->GetDirty(vpn)) {
-                needle = index;
-                return index;
-            }
-        }
-        // Find (0,1)
-        for(int i = 0; i < numEntrys; i++) {
-            index = (needle + i) % numEntrys;
-            thread = map[index].thread;
-            vpn = map[index].vpn;
-            if(!thread->space->GetUse(vpn)) {
-                needle = index;
-                return index;
-            } else {
-                thread->space->ResetUse(vpn);
-            }
+bool
+Coremap::GetUse(unsigned which) {
+    ASSERT(Test(which));
+    unsigned vpn = vpns[which];
+    for (Thread *t = owners[which]; t != nullptr;
+         t = t->space->GetNextSharer(vpn)) {
+        if (t->space->GetUse(vpn)) {
+            return true;
         }
-        // Find (0,0)
-        for(int i = 0; i < numEntrys; i++) {
-            index = (needle + i) % numEntrys;
-            thread = map[index].thread;
-            vpn = map[index].vpn;
-            if(!thread->space->GetUse(vpn) && !thread->space->GetDirty(vpn)) {
-                needle = index;
-                return index;
-            }
+    }
+    return false;
+}
+
+bool
+Coremap::GetDirty(unsigned which) {
+    ASSERT(Test(which));
+    unsigned vpn = vpns[which];
+    for (Thread *t = owners[which]; t != nullptr;
+         t = t->space->GetNextSharer(vpn)) {
+        if (t->space->GetDirty(vpn)) {
+            return true;
         }
-    #endif
-    return rand() % numEntrys;
+    }
+    return false;
+}
+
+void
+Coremap::ResetUse(unsigned which) {
+    ASSERT(Test(which));
+    unsigned vpn = vpns[which];
+    for (Thread *t = owners[which]; t != nullptr;
+         t = t->space->GetNextSharer(vpn)) {
+        t->space->ResetUse(vpn);
+    }
+}
+
+void
+Coremap::Reference(unsigned which) {
+    ASSERT(Test(which));
+    if (trace != nullptr) {
+        fprintf(trace, "%d\n", vpns[which]);
+    }
+    policy->Referenced(which);
+}
+
+void
+Coremap::Pin(unsigned which)
+{
+    ASSERT(Test(which) && !IsPinned(which));
+    flags[which] |= FRAME_PINNED;
+    numPinned++;
+}
+
+/// Every waiter is woken up: each may be waiting for a different frame.
+void
+Coremap::Unpin(unsigned which)
+{
+    ASSERT(IsPinned(which));
+    flags[which] &= ~FRAME_PINNED;
+    numPinned--;
+    for (; numWaiting > 0; numWaiting--) {
+        unpinned->V();
+    }
+}
+
+bool
+Coremap::IsPinned(unsigned which) const
+{
+    ASSERT(which < numEntrys);
+    return flags[which] & FRAME_PINNED;
+}
+
+bool
+Coremap::IsEvictable(unsigned which) const
+{
+    return Test(which) && !IsPinned(which);
+}
+
+bool
+Coremap::HasEvictable() const
+{
+    return numEntrys - numFree > numPinned;
+}
+
+bool
+Coremap::HasPinned() const
+{
+    return numPinned > 0;
+}
+
+void
+Coremap::WaitUnpinned()
+{
+    numWaiting++;
+    lockCoremap->Release();
+    unpinned->P();
+    lockCoremap->Acquire();
+}
+
+int
+Coremap::PickVictim() {
+    ASSERT(HasEvictable());
+    unsigned victim = policy->PickVictim();
+    ASSERT(IsEvictable(victim));
+    return victim;
+}
+
+unsigned
+Coremap::GetSize() const {
+    return numEntrys;
 }
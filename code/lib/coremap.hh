@@ -3,16 +3,66 @@
 
 
 #include "utility.hh"
-#include <list>
 #include "thread.hh"
+#include "threads/semaphore.hh"
 
-class InfoCore {
-    public:
-        bool busy;
-        int vpn;
-        Thread *thread;
+#include <stdio.h>
+
+
+/// Page replacement policies that can be chosen at startup.
+enum PagePolicy {
+    PAGE_RANDOM,   ///< Any frame, at random.
+    PAGE_FIFO,     ///< The frame loaded first.
+    PAGE_CLOCK,    ///< Enhanced second chance, on the use and dirty bits.
+    PAGE_AGING,    ///< LRU approximation by aging counters.
+    PAGE_WSCLOCK,  ///< Working set clock.
+    PAGE_OPTIMAL,  ///< Belady's optimal policy, replaying a recorded trace.
+    NUM_PAGE_POLICIES
+};
+
+extern const char *PAGE_POLICY_NAMES[NUM_PAGE_POLICIES];
+
+/// Policy used unless another one is asked for on the command line; it
+/// still follows the `PRPOLICY_CLOCK` and `FIFO` build flags.
+#if defined(PRPOLICY_CLOCK)
+const PagePolicy DEFAULT_PAGE_POLICY = PAGE_CLOCK;
+#elif defined(FIFO)
+const PagePolicy DEFAULT_PAGE_POLICY = PAGE_FIFO;
+#else
+const PagePolicy DEFAULT_PAGE_POLICY = PAGE_RANDOM;
+#endif
+
+/// Interface of a page replacement policy.
+///
+/// The coremap tells the policy about every frame that gets loaded, freed
+/// or referenced, and asks it for a victim when memory is full.  Policies
+/// read and clear the use and dirty bits through the coremap.
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() {}
+
+    /// Frame `which` was just given to a page.
+    virtual void Loaded(unsigned which) {}
+
+    /// Frame `which` was just freed.
+    virtual void Freed(unsigned which) {}
+
+    /// The page in frame `which` was referenced, that is, its translation
+    /// was just loaded into the TLB.
+    virtual void Referenced(unsigned which) {}
+
+    /// Return the frame to evict, which must be busy and not pinned.  Some
+    /// frames may be free, if eviction happens ahead of need.
+    virtual unsigned PickVictim() = 0;
 };
 
+/// Flags kept for every frame.
+const unsigned char FRAME_BUSY   = 0x1;  ///< Holds a page.
+const unsigned char FRAME_CACHED = 0x2;  ///< Kept by the page cache, even
+                                         ///< if nobody maps it.
+const unsigned char FRAME_PINNED = 0x4;  ///< Being read or written; not to
+                                         ///< be evicted.
+
 class Coremap {
 public:
 
@@ -24,6 +74,13 @@ public:
     /// Uninitialize a Coremap.
     ~Coremap();
 
+    /// Choose the replacement policy; `DEFAULT_PAGE_POLICY` otherwise.
+    ///
+    /// If `traceFile` is not null, `PAGE_OPTIMAL` reads the reference
+    /// string to replay from it; any other policy records the reference
+    /// string of this run into it, one virtual page number per line.
+    void SetPolicy(PagePolicy policy, const char *traceFile = nullptr);
+
     /// Set the “nth” bit.
     void Mark(unsigned which, int vpn, Thread *thread);
 
@@ -44,22 +101,100 @@ public:
     /// Print contents of Coremap.
     void Print() const;
 
+    /// Map frame `which` into the address space of `thread` too, at the
+    /// same virtual page as everybody else.
+    void Share(unsigned which, Thread *thread);
+
+    /// Undo the mapping of frame `which` into the address space of
+    /// `thread`.  Once nobody maps it, the frame is freed, unless it is
+    /// cached.
+    void Unmap(unsigned which, Thread *thread);
+
+    /// Return the number of address spaces mapping frame `which`.
+    unsigned GetRefs(unsigned which) const;
+
+    /// Keep frame `which` while it is busy, even when nobody maps it.
+    void SetCached(unsigned which);
+    bool IsCached(unsigned which) const;
+
+    /// Return one of the threads mapping frame `which`, or null if there
+    /// is none.  The others are found by following
+    /// `AddressSpace::GetNextSharer`.
     Thread *GetThread(unsigned which);
     int GetVPN(unsigned which);
 
+    /// Use and dirty bits of the page held in frame `which`, as seen by
+    /// any of the address spaces mapping it.
+    bool GetUse(unsigned which);
+    bool GetDirty(unsigned which);
+    void ResetUse(unsigned which);
+
+    /// Tell the policy that the page in frame `which` was referenced.
+    void Reference(unsigned which);
+
+    /// Keep busy frame `which` from being evicted while its page is read
+    /// or written with `lockCoremap` released, and let it go again.
+    void Pin(unsigned which);
+    void Unpin(unsigned which);
+    bool IsPinned(unsigned which) const;
+
+    /// Is frame `which` busy, and not pinned?
+    bool IsEvictable(unsigned which) const;
+
+    /// Is any frame evictable?
+    bool HasEvictable() const;
+
+    /// Is any frame pinned?
+    bool HasPinned() const;
+
+    /// Wait until some frame gets unpinned.  Called with `lockCoremap`
+    /// held, which is released meanwhile.
+    void WaitUnpinned();
+
+    /// Choose a frame to take away; the caller evicts its page.  Some frame
+    /// must be evictable.
     int PickVictim();
+
+    /// Return the number of frames.
+    unsigned GetSize() const;
+
 private:
 
+    /// Remove free frame `which` from the free list.
+    void Unlink(unsigned which);
+
     /// Number of bits in the Coremap.
     unsigned numEntrys;
-    /// Bit storage.
-    InfoCore *map;
-    #ifdef FIFO
-        std::list<unsigned int> *fifo;
-    #endif
-    #ifdef PRPOLICY_CLOCK
-        int needle;
-    #endif
+
+    /// Per frame state, one array per field, indexed by frame number: the
+    /// first of the threads mapping the frame, the virtual page number they
+    /// map it at, how many of them there are, and `FRAME_*` flags.
+    ///
+    /// The threads mapping a frame form a chain, threaded through their
+    /// address spaces.
+    Thread **owners;
+    int *vpns;
+    unsigned *refs;
+    unsigned char *flags;
+
+    /// Free frames, in a doubly linked list threaded through two arrays, so
+    /// that allocating, freeing and marking a given frame take constant
+    /// time.  Frames are taken from the head and freed ones pushed there.
+    int *nextFree;
+    int *prevFree;
+    int freeHead;
+    unsigned numFree;
+
+    /// Number of frames pinned, and of threads waiting for one to be
+    /// unpinned.
+    unsigned numPinned;
+    unsigned numWaiting;
+    Semaphore *unpinned;
+
+    ReplacementPolicy *policy;
+
+    /// Where the reference string is being recorded, if anywhere.
+    FILE *trace;
 };
 
 #endif
@@ -0,0 +1,377 @@
+/// Routines implementing the page replacement policies.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "replacement_policy.hh"
+#include "threads/system.hh"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+ReplacementPolicy *
+NewReplacementPolicy(PagePolicy kind, Coremap *coremap,
+                     const char *traceFile)
+{
+    ASSERT(coremap != nullptr);
+
+    switch (kind) {
+        case PAGE_RANDOM:
+            return new RandomPolicy(coremap);
+        case PAGE_FIFO:
+            return new FifoPolicy(coremap);
+        case PAGE_CLOCK:
+            return new ClockPolicy(coremap);
+        case PAGE_AGING:
+            return new AgingPolicy(coremap);
+        case PAGE_WSCLOCK:
+            return new WsClockPolicy(coremap);
+        case PAGE_OPTIMAL:
+            ASSERT(traceFile != nullptr);
+            return new OptimalPolicy(coremap, traceFile);
+        default:
+            ASSERT(false);
+            return nullptr;
+    }
+}
+
+
+RandomPolicy::RandomPolicy(Coremap *coremap)
+{
+    frames = coremap;
+}
+
+unsigned
+RandomPolicy::PickVictim()
+{
+    unsigned victim;
+    do {
+        victim = rand() % frames->GetSize();
+    } while (!frames->IsEvictable(victim));
+    return victim;
+}
+
+
+FifoPolicy::FifoPolicy(Coremap *coremap)
+{
+    frames = coremap;
+    numFrames = coremap->GetSize();
+    next   = new int [numFrames];
+    prev   = new int [numFrames];
+    linked = new bool [numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        linked[i] = false;
+    }
+    oldest = newest = -1;
+}
+
+FifoPolicy::~FifoPolicy()
+{
+    delete [] next;
+    delete [] prev;
+    delete [] linked;
+}
+
+void
+FifoPolicy::Loaded(unsigned which)
+{
+    ASSERT(which < numFrames);
+
+    if (linked[which]) {
+        Freed(which);
+    }
+    prev[which] = newest;
+    next[which] = -1;
+    if (newest != -1) {
+        next[newest] = which;
+    } else {
+        oldest = which;
+    }
+    newest = which;
+    linked[which] = true;
+}
+
+void
+FifoPolicy::Freed(unsigned which)
+{
+    ASSERT(which < numFrames);
+
+    if (!linked[which]) {
+        return;
+    }
+    if (prev[which] != -1) {
+        next[prev[which]] = next[which];
+    } else {
+        oldest = next[which];
+    }
+    if (next[which] != -1) {
+        prev[next[which]] = prev[which];
+    } else {
+        newest = prev[which];
+    }
+    linked[which] = false;
+}
+
+/// The oldest frame that is not pinned.
+unsigned
+FifoPolicy::PickVictim()
+{
+    int victim = oldest;
+    while (victim != -1 && !frames->IsEvictable(victim)) {
+        victim = next[victim];
+    }
+    ASSERT(victim != -1);
+    return victim;
+}
+
+
+ClockPolicy::ClockPolicy(Coremap *coremap)
+{
+    frames = coremap;
+    needle = 0;
+}
+
+unsigned
+ClockPolicy::PickVictim()
+{
+    unsigned n = frames->GetSize();
+    unsigned index;
+
+    // Find (0,0).
+    for (unsigned i = 0; i < n; i++) {
+        index = (needle + i) % n;
+        if (!frames->IsEvictable(index)) {
+            continue;
+        }
+        if (!frames->GetUse(index) && !frames->GetDirty(index)) {
+            needle = index;
+            return index;
+        }
+    }
+    // Find (0,1), giving used frames a second chance.
+    for (unsigned i = 0; i < n; i++) {
+        index = (needle + i) % n;
+        if (!frames->IsEvictable(index)) {
+            continue;
+        }
+        if (!frames->GetUse(index)) {
+            needle = index;
+            return index;
+        }
+        frames->ResetUse(index);
+    }
+    // Every use bit is clear now: find (0,0) again, or else anything.
+    for (unsigned i = 0; i < n; i++) {
+        index = (needle + i) % n;
+        if (!frames->IsEvictable(index)) {
+            continue;
+        }
+        if (!frames->GetUse(index) && !frames->GetDirty(index)) {
+            needle = index;
+            return index;
+        }
+    }
+    // Everything is dirty.
+    while (!frames->IsEvictable(needle)) {
+        needle = (needle + 1) % n;
+    }
+    return needle;
+}
+
+
+AgingPolicy::AgingPolicy(Coremap *coremap)
+{
+    frames = coremap;
+    age = new unsigned char [coremap->GetSize()];
+    for (unsigned i = 0; i < coremap->GetSize(); i++) {
+        age[i] = 0;
+    }
+    start = 0;
+    lastAged = stats->totalTicks;
+}
+
+AgingPolicy::~AgingPolicy()
+{
+    delete [] age;
+}
+
+void
+AgingPolicy::Loaded(unsigned which)
+{
+    age[which] = 0x80;
+}
+
+void
+AgingPolicy::Age(unsigned long periods)
+{
+    // Past eight periods, nothing is left of the old counters.  Use bits
+    // gathered since the last aging count for the latest period.
+    unsigned shift = periods < 8 ? periods : 8;
+    for (unsigned i = 0; i < frames->GetSize(); i++) {
+        if (!frames->Test(i)) {
+            continue;
+        }
+        age[i] >>= shift;
+        if (frames->GetUse(i)) {
+            age[i] |= 0x80;
+            frames->ResetUse(i);
+        }
+    }
+}
+
+unsigned
+AgingPolicy::PickVictim()
+{
+    unsigned n = frames->GetSize();
+    int victim = -1;
+    bool victimDirty = true;
+
+    unsigned long periods = (stats->totalTicks - lastAged) / AGING_PERIOD;
+    if (periods > 0) {
+        Age(periods);
+        lastAged += periods * AGING_PERIOD;
+    }
+
+    for (unsigned i = 0; i < n; i++) {
+        unsigned index = (start + i) % n;
+        if (!frames->IsEvictable(index)) {
+            continue;
+        }
+        bool dirty = frames->GetDirty(index);
+        if (victim == -1 || age[index] < age[victim]
+              || (age[index] == age[victim] && victimDirty && !dirty)) {
+            victim = index;
+            victimDirty = dirty;
+        }
+    }
+    start = (victim + 1) % n;
+    return victim;
+}
+
+
+WsClockPolicy::WsClockPolicy(Coremap *coremap)
+{
+    frames = coremap;
+    lastUse = new unsigned long [coremap->GetSize()];
+    for (unsigned i = 0; i < coremap->GetSize(); i++) {
+        lastUse[i] = 0;
+    }
+    needle = 0;
+}
+
+WsClockPolicy::~WsClockPolicy()
+{
+    delete [] lastUse;
+}
+
+void
+WsClockPolicy::Loaded(unsigned which)
+{
+    lastUse[which] = stats->totalTicks;
+}
+
+unsigned
+WsClockPolicy::PickVictim()
+{
+    unsigned n = frames->GetSize();
+    unsigned long now = stats->totalTicks;
+    int oldest = -1;
+
+    for (unsigned i = 0; i < 2 * n; i++) {
+        unsigned index = needle;
+        needle = (needle + 1) % n;
+        if (!frames->IsEvictable(index)) {
+            continue;
+        }
+        if (frames->GetUse(index)) {
+            frames->ResetUse(index);
+            lastUse[index] = now;
+        } else if (now - lastUse[index] > WORKING_SET_WINDOW
+                   && !frames->GetDirty(index)) {
+            return index;
+        }
+        if (oldest == -1 || lastUse[index] < lastUse[oldest]) {
+            oldest = index;
+        }
+    }
+    return oldest;
+}
+
+
+OptimalPolicy::OptimalPolicy(Coremap *coremap, const char *traceFile)
+{
+    ASSERT(traceFile != nullptr);
+
+    frames = coremap;
+    cursor = 0;
+    lastReferenced = -1;
+
+    FILE *f = fopen(traceFile, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "Cannot open reference string `%s`.\n", traceFile);
+        ASSERT(false);
+    }
+    int vpn;
+    while (fscanf(f, "%d", &vpn) == 1) {
+        ASSERT(vpn >= 0);
+        if ((unsigned) vpn >= uses.size()) {
+            uses.resize(vpn + 1);
+        }
+        uses[vpn].push_back(references.size());
+        references.push_back(vpn);
+    }
+    fclose(f);
+}
+
+void
+OptimalPolicy::Referenced(unsigned which)
+{
+    int vpn = frames->GetVPN(which);
+    lastReferenced = which;
+    unsigned end = std::min<unsigned>(cursor + OPTIMAL_RESYNC_WINDOW,
+                                      references.size());
+    for (unsigned k = cursor; k < end; k++) {
+        if (references[k] == vpn) {
+            cursor = k + 1;
+            return;
+        }
+    }
+}
+
+unsigned
+OptimalPolicy::NextUse(int vpn) const
+{
+    if (vpn < 0 || (unsigned) vpn >= uses.size()) {
+        return references.size();  // Never.
+    }
+    const std::vector<unsigned> &positions = uses[vpn];
+    std::vector<unsigned>::const_iterator it
+      = std::lower_bound(positions.begin(), positions.end(), cursor);
+    return it != positions.end() ? *it : references.size();
+}
+
+unsigned
+OptimalPolicy::PickVictim()
+{
+    unsigned victim = 0;
+    unsigned farthest = 0;
+    bool found = false;
+
+    for (unsigned i = 0; i < frames->GetSize(); i++) {
+        if (!frames->IsEvictable(i) || (int) i == lastReferenced) {
+            continue;
+        }
+        unsigned next = NextUse(frames->GetVPN(i));
+        if (!found || next > farthest) {
+            found = true;
+            victim = i;
+            farthest = next;
+        }
+    }
+    // The page referenced last goes only if nothing else can.
+    return found ? victim : lastReferenced;
+}
@@ -0,0 +1,169 @@
+/// Page replacement policies for the coremap.
+///
+/// Every policy keeps constant-time bookkeeping per frame loaded, freed or
+/// referenced.  Picking a victim is linear in the number of frames for all
+/// but random and FIFO: the clock-like policies sweep the frames at most
+/// twice, aging compares every counter, and the optimal one looks up the
+/// next use of every resident page in the recorded trace.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_REPLACEMENTPOLICY__HH
+#define NACHOS_LIB_REPLACEMENTPOLICY__HH
+
+
+#include "coremap.hh"
+
+#include <vector>
+
+
+/// Create a policy of kind `kind` for the frames of `coremap`.
+///
+/// `traceFile` is only used by `PAGE_OPTIMAL`, which requires it.
+ReplacementPolicy *NewReplacementPolicy(PagePolicy kind, Coremap *coremap,
+                                        const char *traceFile);
+
+/// Any evictable frame, at random.
+class RandomPolicy : public ReplacementPolicy {
+public:
+    RandomPolicy(Coremap *coremap);
+
+    unsigned PickVictim();
+
+private:
+    Coremap *frames;
+};
+
+/// The frame that was loaded first.
+///
+/// Frames are kept in a doubly linked list threaded through two arrays, so
+/// that freeing a frame in the middle takes constant time.
+class FifoPolicy : public ReplacementPolicy {
+public:
+    FifoPolicy(Coremap *coremap);
+    ~FifoPolicy();
+
+    void Loaded(unsigned which);
+    void Freed(unsigned which);
+    unsigned PickVictim();
+
+private:
+    Coremap *frames;
+    unsigned numFrames;
+    int *next;     ///< Next frame loaded after this one, or -1.
+    int *prev;     ///< Previous frame loaded before this one, or -1.
+    bool *linked;
+    int oldest;
+    int newest;
+};
+
+/// Enhanced second chance: look for a frame that is neither used nor
+/// dirty; then for one that is not used, clearing use bits on the way;
+/// then, once every use bit is clear, for a clean one again, and finally
+/// for any.
+class ClockPolicy : public ReplacementPolicy {
+public:
+    ClockPolicy(Coremap *coremap);
+
+    unsigned PickVictim();
+
+private:
+    Coremap *frames;
+    unsigned needle;
+};
+
+/// LRU approximation: every `AGING_PERIOD` ticks, each frame's counter is
+/// shifted right and its use bit shifted in from the left; the frame with
+/// the lowest counter goes, clean frames first on ties.
+///
+/// Counters are aged when a victim is needed, by as many periods as have
+/// gone by, so the rate does not depend on how often pages fault and the
+/// sweep is paid at most once per period.  Newly loaded frames count as
+/// used in the current period.
+class AgingPolicy : public ReplacementPolicy {
+public:
+    AgingPolicy(Coremap *coremap);
+    ~AgingPolicy();
+
+    void Loaded(unsigned which);
+    unsigned PickVictim();
+
+private:
+    Coremap *frames;
+    unsigned char *age;
+    unsigned start;  ///< Where the next search starts, to spread ties.
+    unsigned long lastAged;  ///< When the current period started.
+
+    /// Shift every counter by `periods`, taking in the use bits.
+    void Age(unsigned long periods);
+};
+
+/// Length of an aging period, in ticks of simulated time.
+const unsigned long AGING_PERIOD = 1000;
+
+/// Working set clock: sweep the frames, and take the first clean one that
+/// has not been used for `WORKING_SET_WINDOW` ticks.  Used frames get their
+/// time of last use refreshed.  If no frame qualifies after two sweeps, the
+/// one unused for the longest goes.
+class WsClockPolicy : public ReplacementPolicy {
+public:
+    WsClockPolicy(Coremap *coremap);
+    ~WsClockPolicy();
+
+    void Loaded(unsigned which);
+    unsigned PickVictim();
+
+private:
+    Coremap *frames;
+    unsigned long *lastUse;
+    unsigned needle;
+};
+
+/// Width of the working set window, in ticks of simulated time.
+const unsigned long WORKING_SET_WINDOW = 5000;
+
+/// Belady's optimal policy: evict the page whose next reference lies
+/// farthest in the future.
+///
+/// The future is a reference string recorded by an earlier run of the same
+/// workload (see `Coremap::SetPolicy`), preferably with enough frames that
+/// nothing got evicted, so that it does not depend on the policy used.
+/// As references arrive, they are matched against the string, skipping
+/// ahead a little if it has drifted; references that do not match are
+/// ignored.  Pages are identified by virtual page number only, so it is
+/// meant for one program at a time.
+///
+/// TLB hits are not part of the string, so the page referenced last is
+/// never chosen: the faulting instruction may well need it too.
+class OptimalPolicy : public ReplacementPolicy {
+public:
+    OptimalPolicy(Coremap *coremap, const char *traceFile);
+
+    void Referenced(unsigned which);
+    unsigned PickVictim();
+
+private:
+    /// Position in the reference string of the next use of `vpn`, at or
+    /// after the current one.
+    unsigned NextUse(int vpn) const;
+
+    Coremap *frames;
+
+    /// The reference string: virtual page numbers, in order.
+    std::vector<int> references;
+
+    /// Positions in the reference string where each page is referenced.
+    std::vector<std::vector<unsigned> > uses;
+
+    unsigned cursor;  ///< Next position expected.
+
+    int lastReferenced;  ///< Frame referenced last, or -1.
+};
+
+/// How far ahead of the expected position a reference is looked for.
+const unsigned OPTIMAL_RESYNC_WINDOW = 64;
+
+
+#endif
@@ -0,0 +1,762 @@
+/// Routines to translate and run basic blocks of user code.
+///
+/// The handlers below mirror, case by case, the `switch` in
+/// `Machine::ExecInstruction`; instructions that are rare or awkward (such
+/// as unaligned loads and stores, multiplications or system calls) are
+/// simply handed back to `ExecInstruction`.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "block_engine.hh"
+#include "machine.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Finish an instruction: apply the delayed load in progress, record the
+/// new one, and advance the program counters.  Same as the end of
+/// `Machine::ExecInstruction`.
+static inline bool
+Retire(int *r, int pcAfter, unsigned nextLoadReg = 0, int nextLoadValue = 0)
+{
+    r[r[LOAD_REG]] = r[LOAD_VALUE_REG];
+    r[LOAD_REG] = nextLoadReg;
+    r[LOAD_VALUE_REG] = nextLoadValue;
+    r[0] = 0;  // And always make sure R0 stays zero.
+
+    r[PREV_PC_REG] = r[PC_REG];
+    r[PC_REG] = r[NEXT_PC_REG];
+    r[NEXT_PC_REG] = pcAfter;
+    return true;
+}
+
+static bool
+DoGeneric(Machine *m, int *r, const Instruction *instr)
+{
+    return m->ExecInstruction(instr);
+}
+
+static bool
+DoAdd(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int sum = r[instr->rs] + r[instr->rt];
+    if (!((r[instr->rs] ^ r[instr->rt]) & SIGN_BIT)
+          && (r[instr->rs] ^ sum) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return false;
+    }
+    r[instr->rd] = sum;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoAddi(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int sum = r[instr->rs] + instr->extra;
+    if (!((r[instr->rs] ^ instr->extra) & SIGN_BIT)
+          && (instr->extra ^ sum) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return false;
+    }
+    r[instr->rt] = sum;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSub(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int diff = r[instr->rs] - r[instr->rt];
+    if ((r[instr->rs] ^ r[instr->rt]) & SIGN_BIT
+          && (r[instr->rs] ^ diff) & SIGN_BIT) {
+        m->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return false;
+    }
+    r[instr->rd] = diff;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoAddiu(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = r[instr->rs] + instr->extra;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoAddu(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rs] + r[instr->rt];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSubu(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rs] - r[instr->rt];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoAnd(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rs] & r[instr->rt];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoAndi(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = r[instr->rs] & (instr->extra & 0xFFFF);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoOr(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rs] | r[instr->rt];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoOri(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = r[instr->rs] | (instr->extra & 0xFFFF);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoXor(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rs] ^ r[instr->rt];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoXori(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = r[instr->rs] ^ (instr->extra & 0xFFFF);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoNor(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = ~(r[instr->rs] | r[instr->rt]);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoLui(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = instr->extra << 16;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSll(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rt] << instr->extra;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSllv(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rt] << (r[instr->rs] & 0x1F);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSra(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rt] >> instr->extra;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSrav(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[instr->rt] >> (r[instr->rs] & 0x1F);
+    return Retire(r, pcAfter);
+}
+
+/// NOTE: like `ExecInstruction`, shifts through a signed integer.
+static bool
+DoSrl(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int tmp = r[instr->rt];
+    tmp >>= instr->extra;
+    r[instr->rd] = tmp;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSrlv(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int tmp = r[instr->rt];
+    tmp >>= r[instr->rs] & 0x1F;
+    r[instr->rd] = tmp;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSlt(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = (r[instr->rs] < r[instr->rt]) ? 1 : 0;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSlti(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rt] = (r[instr->rs] < instr->extra) ? 1 : 0;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSltiu(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    unsigned rs = r[instr->rs];
+    unsigned imm = instr->extra;
+    r[instr->rt] = (rs < imm) ? 1 : 0;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSltu(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    unsigned rs = r[instr->rs];
+    unsigned rt = r[instr->rt];
+    r[instr->rd] = (rs < rt) ? 1 : 0;
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoMfhi(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[HI_REG];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoMflo(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[instr->rd] = r[LO_REG];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoMthi(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[HI_REG] = r[instr->rs];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoMtlo(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[LO_REG] = r[instr->rs];
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBeq(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (r[instr->rs] == r[instr->rt]) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBne(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (r[instr->rs] != r[instr->rt]) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBgtz(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (r[instr->rs] > 0) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBlez(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (r[instr->rs] <= 0) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBgez(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (!(r[instr->rs] & SIGN_BIT)) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoBltz(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (r[instr->rs] & SIGN_BIT) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoJ(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    pcAfter = (pcAfter & 0xF0000000) | IndexToAddr(instr->extra);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoJal(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+    pcAfter = (pcAfter & 0xF0000000) | IndexToAddr(instr->extra);
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoJr(Machine *m, int *r, const Instruction *instr)
+{
+    return Retire(r, r[instr->rs]);
+}
+
+static bool
+DoJalr(Machine *m, int *r, const Instruction *instr)
+{
+    r[instr->rd] = r[NEXT_PC_REG] + 4;
+    return Retire(r, r[instr->rs]);
+}
+
+static bool
+DoLw(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int addr = r[instr->rs] + instr->extra;
+    int value;
+    if (addr & 0x3) {
+        m->RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return false;
+    }
+    if (!m->ReadMem(addr, 4, &value)) {
+        return false;
+    }
+    return Retire(r, pcAfter, instr->rt, value);
+}
+
+static bool
+DoLb(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    int addr = r[instr->rs] + instr->extra;
+    int value;
+    if (!m->ReadMem(addr, 1, &value)) {
+        return false;
+    }
+    if (value & 0x80 && instr->opCode == OP_LB) {
+        value |= 0xFFFFFF00;
+    } else {
+        value &= 0xFF;
+    }
+    return Retire(r, pcAfter, instr->rt, value);
+}
+
+static bool
+DoSw(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (!m->WriteMem((unsigned) (r[instr->rs] + instr->extra),
+                     4, r[instr->rt])) {
+        return false;
+    }
+    return Retire(r, pcAfter);
+}
+
+static bool
+DoSb(Machine *m, int *r, const Instruction *instr)
+{
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    if (!m->WriteMem((unsigned) (r[instr->rs] + instr->extra),
+                     1, r[instr->rt])) {
+        return false;
+    }
+    return Retire(r, pcAfter);
+}
+
+/// Choose the handler for `opCode`.
+///
+/// Also tell whether the instruction ends a block: `branch` is set if it
+/// may transfer control (and then only its delay slot follows it), and
+/// `trap` if it always traps into the kernel.
+static InstrHandler
+SelectHandler(unsigned char opCode, bool *branch, bool *trap)
+{
+    *branch = false;
+    *trap   = false;
+    switch (opCode) {
+        case OP_ADD:   return DoAdd;
+        case OP_ADDI:  return DoAddi;
+        case OP_ADDIU: return DoAddiu;
+        case OP_ADDU:  return DoAddu;
+        case OP_AND:   return DoAnd;
+        case OP_ANDI:  return DoAndi;
+        case OP_LUI:   return DoLui;
+        case OP_MFHI:  return DoMfhi;
+        case OP_MFLO:  return DoMflo;
+        case OP_MTHI:  return DoMthi;
+        case OP_MTLO:  return DoMtlo;
+        case OP_NOR:   return DoNor;
+        case OP_OR:    return DoOr;
+        case OP_ORI:   return DoOri;
+        case OP_SLL:   return DoSll;
+        case OP_SLLV:  return DoSllv;
+        case OP_SLT:   return DoSlt;
+        case OP_SLTI:  return DoSlti;
+        case OP_SLTIU: return DoSltiu;
+        case OP_SLTU:  return DoSltu;
+        case OP_SRA:   return DoSra;
+        case OP_SRAV:  return DoSrav;
+        case OP_SRL:   return DoSrl;
+        case OP_SRLV:  return DoSrlv;
+        case OP_SUB:   return DoSub;
+        case OP_SUBU:  return DoSubu;
+        case OP_XOR:   return DoXor;
+        case OP_XORI:  return DoXori;
+
+        case OP_LB:
+        case OP_LBU:   return DoLb;
+        case OP_LW:    return DoLw;
+        case OP_SB:    return DoSb;
+        case OP_SW:    return DoSw;
+
+        case OP_BEQ:   *branch = true; return DoBeq;
+        case OP_BNE:   *branch = true; return DoBne;
+        case OP_BGTZ:  *branch = true; return DoBgtz;
+        case OP_BLEZ:  *branch = true; return DoBlez;
+        case OP_BGEZ:  *branch = true; return DoBgez;
+        case OP_BLTZ:  *branch = true; return DoBltz;
+        case OP_J:     *branch = true; return DoJ;
+        case OP_JAL:   *branch = true; return DoJal;
+        case OP_JR:    *branch = true; return DoJr;
+        case OP_JALR:  *branch = true; return DoJalr;
+
+        case OP_BGEZAL:
+        case OP_BLTZAL:
+            *branch = true;
+            return DoGeneric;
+
+        case OP_SYSCALL:
+        case OP_RES:
+        case OP_UNIMP:
+            *trap = true;
+            return DoGeneric;
+
+        default:
+            return DoGeneric;
+    }
+}
+
+BlockEngine::BlockEngine(Machine *m)
+{
+    ASSERT(m != nullptr);
+
+    cpu       = m;
+    registers = m->registers;
+    mmu       = m->GetMMU();
+    blocks    = new Block * [MEMORY_SIZE / 4];
+    for (unsigned i = 0; i < MEMORY_SIZE / 4; i++) {
+        blocks[i] = nullptr;
+    }
+    horizon     = 0;
+    jit         = nullptr;
+    jitLockstep = false;
+}
+
+BlockEngine::~BlockEngine()
+{
+    for (unsigned i = 0; i < MEMORY_SIZE / 4; i++) {
+        delete blocks[i];
+    }
+    delete [] blocks;
+    delete jit;
+}
+
+bool
+BlockEngine::EnableJit(bool lockstep)
+{
+    if (jit == nullptr) {
+        jit = new JitCompiler(registers, &horizon);
+    }
+    if (!jit->IsAvailable()) {
+        delete jit;
+        jit = nullptr;
+        return false;
+    }
+    jitLockstep = lockstep;
+    return true;
+}
+
+/// Fill `block` with the instructions starting at physical address
+/// `physAddr`, up to the end of the basic block or of the frame, whichever
+/// comes first.
+void
+BlockEngine::Translate(Block *block, unsigned physAddr)
+{
+    ASSERT(block != nullptr);
+
+    block->frame      = physAddr / PAGE_SIZE;
+    block->generation = mmu->GetFrameGeneration(block->frame);
+    block->length     = 0;
+    block->runs       = 0;
+    block->compiled   = false;
+
+    unsigned frameEnd = (block->frame + 1) * PAGE_SIZE;
+    bool     inDelaySlot = false;
+    for (unsigned a = physAddr; a < frameEnd; a += 4) {
+        const Instruction *instr = mmu->DecodeInstruction(a);
+        bool branch, trap;
+        Block::Entry *e = &block->entries[block->length++];
+        e->handler = SelectHandler(instr->opCode, &branch, &trap);
+        e->instr   = instr;
+        e->native  = nullptr;
+        if (inDelaySlot || trap) {
+            break;
+        }
+        inDelaySlot = branch;
+    }
+    DEBUG('b', "Translated block at physical address 0x%X, %u instructions\n",
+          physAddr, block->length);
+}
+
+Block *
+BlockEngine::GetBlock(unsigned physAddr)
+{
+    Block *block = blocks[physAddr / 4];
+    if (block == nullptr) {
+        block = blocks[physAddr / 4] = new Block;
+        Translate(block, physAddr);
+    } else if (block->generation != mmu->GetFrameGeneration(block->frame)) {
+        Translate(block, physAddr);
+    }
+    return block;
+}
+
+void
+BlockEngine::Compile(Block *block)
+{
+    ASSERT(block != nullptr);
+    ASSERT(jit != nullptr);
+
+    block->compiled = true;
+    if (jit->Compile(block)) {
+        return;
+    }
+    if (!jit->CanFlush()) {
+        return;  // Try again later, once every thread is out of it.
+    }
+
+    // Out of room: start over, forgetting every compiled block.
+    jit->Flush();
+    for (unsigned i = 0; i < MEMORY_SIZE / 4; i++) {
+        Block *b = blocks[i];
+        if (b != nullptr && b->compiled) {
+            for (unsigned j = 0; j < b->length; j++) {
+                b->entries[j].native = nullptr;
+            }
+            b->compiled = false;
+            b->runs     = 0;
+        }
+    }
+    block->compiled = jit->Compile(block);
+}
+
+unsigned
+BlockEngine::RunCompiled(Block *block, unsigned index, bool *fired)
+{
+    ASSERT(block != nullptr);
+    ASSERT(fired != nullptr);
+
+    int before[NUM_TOTAL_REGS];
+    unsigned generation = block->generation;
+    if (jitLockstep) {
+        memcpy(before, registers, sizeof before);
+    }
+
+    unsigned result = jit->Run(block->entries[index].native);
+    unsigned next = result >> 1;
+    *fired = result & 1;
+
+    // If the block was retranslated while this thread was switched out,
+    // there is nothing left to compare against.
+    if (jitLockstep && generation == block->generation
+          && generation == mmu->GetFrameGeneration(block->frame)) {
+        CheckCompiled(block, index, next, before);
+    }
+    return next;
+}
+
+void
+BlockEngine::CheckCompiled(Block *block, unsigned from, unsigned to,
+                           const int *before)
+{
+    ASSERT(block != nullptr);
+    ASSERT(from < to && to <= block->length);
+    ASSERT(before != nullptr);
+
+    int expected[NUM_TOTAL_REGS];
+    memcpy(expected, before, sizeof expected);
+    for (unsigned i = from; i < to; i++) {
+        const Block::Entry *entry = &block->entries[i];
+        ASSERT(entry->handler != DoGeneric);
+        entry->handler(cpu, expected, entry->instr);
+    }
+
+    for (unsigned r = 0; r < NUM_TOTAL_REGS; r++) {
+        if (registers[r] != expected[r]) {
+            fprintf(stderr, "JIT mismatch after running from PC 0x%X"
+                            " to 0x%X: register %u is 0x%X, should be"
+                            " 0x%X.\n", before[PC_REG], registers[PC_REG],
+                    r, registers[r], expected[r]);
+            ASSERT(false);
+        }
+    }
+}
+
+/// Until `horizon`, advancing time is all `Interrupt::OneTick` would do.
+bool
+BlockEngine::Tick()
+{
+    if (stats->totalTicks + USER_TICK < horizon) {
+        interrupt->UserTick();
+        return false;
+    }
+    bool fired = interrupt->OneTick();
+    horizon = interrupt->NextEventTick();
+    return fired;
+}
+
+void
+BlockEngine::RunBlock()
+{
+    unsigned pc = registers[PC_REG];
+    unsigned physAddr;
+    ExceptionType e = mmu->TranslateInstruction(pc, &physAddr);
+    if (e != NO_EXCEPTION) {
+        cpu->RaiseException(e, pc);
+        interrupt->OneTick();
+        return;
+    }
+
+    // The TLB sees every later fetch from the block go through the same
+    // entry as this one.
+    int tlbIndex = mmu->GetLastTlbIndex();
+
+    // The kernel may have run since the last block, so start afresh.
+    horizon = interrupt->NextEventTick();
+
+    Block *block = GetBlock(physAddr);
+    if (jit != nullptr && !block->compiled
+          && ++block->runs >= JIT_THRESHOLD) {
+        Compile(block);
+    }
+
+    for (unsigned i = 0; i < block->length; ) {
+        const Block::Entry *entry = &block->entries[i];
+        unsigned next;
+
+        // Compiled code runs straight through to the end of the block, so
+        // it cannot start in a delay slot; it also assumes there is no
+        // delayed load to finish.
+        if (entry->native != nullptr
+              && (unsigned) registers[NEXT_PC_REG] == pc + 4
+              && registers[LOAD_REG] == 0 && registers[LOAD_VALUE_REG] == 0) {
+            // It makes no memory accesses either, so to the TLB its
+            // fetches are just as many accesses in a row to one entry, and
+            // the first of them is enough.
+            if (i > 0) {
+                mmu->TouchTlbFetch(tlbIndex);
+            }
+            bool fired;
+            next = RunCompiled(block, i, &fired);
+            if (fired) {
+                return;
+            }
+        } else {
+            // The fetch itself; the translation done above is good for the
+            // whole page.
+            if (i > 0) {
+                mmu->TouchTlbFetch(tlbIndex);
+            }
+            stats->numAccessMemory++;
+            stats->numHits++;
+
+            bool ok = entry->handler(cpu, registers, entry->instr);
+            if (Tick() || !ok) {
+                return;  // The kernel ran; the block may not be valid
+                         // anymore.
+            }
+            next = i + 1;
+        }
+
+        pc += 4 * (next - i);
+        i = next;
+        if ((unsigned) registers[PC_REG] != pc
+              || block->generation != mmu->GetFrameGeneration(block->frame)) {
+            return;  // Taken branch, or the code was just overwritten.
+        }
+    }
+}
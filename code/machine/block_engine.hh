@@ -0,0 +1,138 @@
+/// Data structures for executing user code one basic block at a time.
+///
+/// The plain simulator in `mips_sim.cc` fetches, translates and decodes
+/// every instruction, and then dispatches it through a big `switch`.  The
+/// block engine instead splits user code into basic blocks (straight-line
+/// runs of instructions ending at a branch or jump plus its delay slot, at a
+/// system call, or at the end of a page), and translates every block into a
+/// chain of pre-bound handlers: one host function per instruction, chosen
+/// once when the block is built.  Running a block then amounts to calling
+/// those handlers in order.
+///
+/// Every handler has exactly the same effect as `Machine::ExecInstruction`
+/// on the same instruction: delay slots, delayed loads and exceptions are
+/// all handled through the very same machine registers.  The engine only
+/// relies on the following to stay exact:
+///
+/// * all the instructions of a block belong to the same page, so after the
+///   first one is fetched, the rest of them would be fetched through the
+///   same translation (nothing can change it without trapping into the
+///   kernel, which ends the block);
+/// * blocks are indexed by physical address, and the instruction cache
+///   reports through a generation counter whenever a frame is written to or
+///   reused, so stale blocks are rebuilt;
+/// * the block is left as soon as control does not flow to the next
+///   instruction, an exception is raised, or an interrupt handler runs.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_BLOCKENGINE__HH
+#define NACHOS_MACHINE_BLOCKENGINE__HH
+
+
+#include "instruction.hh"
+#include "jit_compiler.hh"
+#include "mmu.hh"
+
+
+class Machine;
+
+/// A pre-bound handler for a single instruction.
+///
+/// Returns false if the instruction raised an exception.
+typedef bool (*InstrHandler)(Machine *m, int *r, const Instruction *instr);
+
+/// The maximum number of instructions in a block: a whole page.
+const unsigned MAX_BLOCK_LENGTH = PAGE_SIZE / 4;
+
+/// A translated basic block.
+class Block {
+public:
+    struct Entry {
+        InstrHandler handler;
+        const Instruction *instr;
+        JitCode native;  ///< Compiled code from here on, if any.
+    };
+
+    unsigned frame;       ///< Physical frame holding the block.
+    unsigned generation;  ///< Generation of `frame` when translated.
+    unsigned length;      ///< Number of instructions.
+    unsigned runs;        ///< Times it has been run, while not compiled.
+    bool compiled;        ///< Whether the JIT already went through it.
+    Entry entries[MAX_BLOCK_LENGTH];
+};
+
+class BlockEngine {
+public:
+
+    /// Initialize an engine for `m`, with no translated blocks.
+    BlockEngine(Machine *m);
+
+    /// Discard every translated block.
+    ~BlockEngine();
+
+    /// Run the basic block starting at the current program counter,
+    /// advancing simulated time after each instruction just as
+    /// `Machine::Run` does.
+    ///
+    /// Executes at least one instruction (or raises the exception caused by
+    /// fetching it).
+    void RunBlock();
+
+    /// Compile blocks that run often into host code.
+    ///
+    /// If `lockstep` is set, every stretch of compiled code is also run by
+    /// the handlers on a copy of the registers, and both register files are
+    /// compared afterwards.
+    ///
+    /// Return false if the host does not support it.
+    bool EnableJit(bool lockstep);
+
+private:
+
+    /// Return the block starting at physical address `physAddr`,
+    /// translating it if needed.
+    Block *GetBlock(unsigned physAddr);
+
+    /// Translate the block starting at physical address `physAddr`.
+    void Translate(Block *block, unsigned physAddr);
+
+    /// Compile `block`, making room for it if needed.
+    void Compile(Block *block);
+
+    /// Run the compiled code of `block` starting at instruction `index`.
+    ///
+    /// Return the index of the next instruction to run, and set `fired` if
+    /// an interrupt handler ran.
+    unsigned RunCompiled(Block *block, unsigned index, bool *fired);
+
+    /// Run the handlers of instructions `from` to `to` (excluded) of
+    /// `block` on a copy of `before`, and check that the result matches
+    /// the current registers.
+    void CheckCompiled(Block *block, unsigned from, unsigned to,
+                       const int *before);
+
+    /// Advance simulated time after running one instruction.
+    ///
+    /// Return true if some interrupt handler ran.
+    bool Tick();
+
+    Machine *cpu;
+    int *registers;
+    MMU *mmu;
+
+    /// Translated blocks, indexed by the physical word they start at.
+    Block **blocks;
+
+    /// Time of the next pending interrupt, as of the last time the kernel
+    /// ran (see `Interrupt::NextEventTick`).
+    unsigned long horizon;
+
+    JitCompiler *jit;  ///< Null unless enabled.
+    bool jitLockstep;
+};
+
+
+#endif
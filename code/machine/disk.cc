@@ -26,8 +26,6 @@
 static const unsigned MAGIC_NUMBER = 0x456789AB;
 static const unsigned MAGIC_SIZE = sizeof (int);
 
-static const unsigned DISK_SIZE = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
-
 /// dummy procedure because we cannot take a pointer of a member function
 static void
 DiskDone(void *arg)
@@ -69,7 +67,8 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
           // Write magic number.
 
         // Need to write at end of file, so that reads will not return EOF.
-        SystemDep::Lseek(fileno, DISK_SIZE - sizeof (int), 0);
+        unsigned diskSize = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
+        SystemDep::Lseek(fileno, diskSize - sizeof (int), 0);
         SystemDep::WriteFile(fileno, (char *) &tmp, sizeof (int));
     }
     active = false;
@@ -102,7 +101,8 @@ PrintSector(bool writing, unsigned sector, const char *data)
 
 /// Disk::ReadRequest/WriteRequest
 ///
-/// Simulate a request to read/write a single disk sector.
+/// Simulate a request to read/write a single disk sector, or a list of
+/// them.
 ///
 /// Do the read/write immediately to the UNIX file.  Set up an interrupt
 /// handler to be called later, that will notify the caller when the
@@ -114,49 +114,72 @@ PrintSector(bool writing, unsigned sector, const char *data)
 /// * `sectorNumber` is the disk sector to read/write.
 /// * `data` are the bytes to be written, the buffer to hold the incoming
 ///   bytes.
+/// * `vector` lists `count` sectors, and the data of each.
 void
 Disk::ReadRequest(unsigned sectorNumber, char *data)
 {
-    ASSERT(data != nullptr);
-
-    int ticks = ComputeLatency(sectorNumber, false);
-
-    ASSERT(!active);  // only one request at a time
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    DiskVector vector = { sectorNumber, data };
+    Request(&vector, 1, false);
+}
 
-    DEBUG('d', "Reading from sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::Read(fileno, data, SECTOR_SIZE);
-    if (debug.IsEnabled('d')) {
-        PrintSector(false, sectorNumber, data);
-    }
+void
+Disk::WriteRequest(unsigned sectorNumber, const char *data)
+{
+    DiskVector vector = { sectorNumber, (char *) data };
+    Request(&vector, 1, true);
+}
 
-    active = true;
-    UpdateLast(sectorNumber);
-    stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
+void
+Disk::ReadRequest(const DiskVector *vector, unsigned count)
+{
+    Request(vector, count, false);
 }
 
 void
-Disk::WriteRequest(unsigned sectorNumber, const char *data)
+Disk::WriteRequest(const DiskVector *vector, unsigned count)
 {
-    ASSERT(data != nullptr);
+    Request(vector, count, true);
+}
 
-    int ticks = ComputeLatency(sectorNumber, true);
+void
+Disk::Request(const DiskVector *vector, unsigned count, bool writing)
+{
+    ASSERT(vector != nullptr);
+    ASSERT(count > 0);
 
-    ASSERT(!active);
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(!active);  // only one request at a time
 
-    DEBUG('d', "Writing to sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
-    if (debug.IsEnabled('d')) {
-        PrintSector(true, sectorNumber, data);
+    for (unsigned i = 0; i < count; i++) {
+        unsigned sectorNumber = vector[i].sector;
+        char *data = vector[i].data;
+        ASSERT(data != nullptr);
+        ASSERT(sectorNumber < NUM_SECTORS);
+
+        DEBUG('d', "%s sector %u\n",
+              writing ? "Writing to" : "Reading from", sectorNumber);
+        SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+        if (writing) {
+            SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
+        } else {
+            SystemDep::Read(fileno, data, SECTOR_SIZE);
+        }
+        if (debug.IsEnabled('d')) {
+            PrintSector(writing, sectorNumber, data);
+        }
     }
 
+    int ticks = Follow(vector, count, writing, &lastSector, &bufferInit);
+    DEBUG('d', "Request latency = %d, last sector = %u, %d\n",
+          ticks, lastSector, bufferInit);
+
     active = true;
-    UpdateLast(sectorNumber);
-    stats->numDiskWrites++;
+    if (writing) {
+        stats->numDiskWrites++;
+        stats->numDiskSectorsWritten += count;
+    } else {
+        stats->numDiskReads++;
+        stats->numDiskSectorsRead += count;
+    }
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
@@ -176,22 +199,24 @@ Diff(unsigned a, unsigned b)
 }
 
 /// Returns how long it will take to position the disk head over the correct
-/// track on the disk.  Since when we finish seeking, we are likely to be in
-/// the middle of a sector that is rotating past the head, we also return how
-/// long until the head is at the next sector boundary.
+/// track on the disk, from the track of sector `from`, starting at time
+/// `when`.  Since when we finish seeking, we are likely to be in the middle
+/// of a sector that is rotating past the head, we also return how long until
+/// the head is at the next sector boundary.
 ///
 /// Disk seeks at one track per `SEEK_TIME` ticks (cf. `stats.hh`) and
 /// rotates at one sector per `ROTATION_TIME` ticks.
 unsigned
-Disk::TimeToSeek(unsigned newSector, unsigned *rotation)
+Disk::TimeToSeek(unsigned from, unsigned newSector, unsigned long when,
+                 unsigned *rotation)
 {
     ASSERT(rotation != nullptr);
 
     unsigned newTrack = newSector / SECTORS_PER_TRACK;
-    unsigned oldTrack = lastSector / SECTORS_PER_TRACK;
+    unsigned oldTrack = from / SECTORS_PER_TRACK;
     unsigned seek = Diff(newTrack, oldTrack) * SEEK_TIME;
       // How long will seek take?
-    unsigned over = (stats->totalTicks + seek) % ROTATION_TIME;
+    unsigned over = (when + seek) % ROTATION_TIME;
       // Will we be in the middle of a sector when we finish the seek?
 
     *rotation = 0;
@@ -216,55 +241,82 @@ Disk::ModuloDiff(unsigned to, unsigned from)
 /// the current position of the disk head.
 ///
 ///     Latency = seek time + rotational latency + transfer time
+int
+Disk::ComputeLatency(unsigned newSector, bool writing)
+{
+    DiskVector vector = { newSector, nullptr };
+    return ComputeLatency(&vector, 1, writing);
+}
+
+/// Return how long will it take to read/write the sectors in `vector`, one
+/// after the other, from the current position of the disk head.
+int
+Disk::ComputeLatency(const DiskVector *vector, unsigned count, bool writing)
+{
+    unsigned last = lastSector;
+    int init = bufferInit;
+    return Follow(vector, count, writing, &last, &init);
+}
+
+/// Follow the disk head through the sectors in `vector`, adding up how
+/// long each of them takes:
+///
+///     Latency = seek time + rotational latency + transfer time
 ///
 /// Disk seeks at one track per `SEEK_TIME` ticks (cf. `stats.hh`) and
 /// rotates at one sector per `ROTATION_TIME` ticks.
 ///
 /// To find the rotational latency, we first must figure out where the disk
 /// head will be after the seek (if any).  We then figure out how long it
-/// will take to rotate completely past newSector after that point.
+/// will take to rotate completely past the sector after that point.  Once a
+/// sector is transferred, the head is right at the start of the next one, so
+/// consecutive sectors on a track stream by at one per `ROTATION_TIME`.
 ///
 /// The disk also has a "track buffer"; the disk continuously reads the
 /// contents of the current disk track into the buffer.  This allows read
 /// requests to the current track to be satisfied more quickly.  The contents
 /// of the track buffer are discarded after every seek to a new track.
-int
-Disk::ComputeLatency(unsigned newSector, bool writing)
+///
+/// `*last` and `*init` are the most recently requested sector, and when the
+/// track buffer started being loaded; they are left as they will be after
+/// the transfer, so that we know what is in the track buffer.
+unsigned
+Disk::Follow(const DiskVector *vector, unsigned count, bool writing,
+             unsigned *last, int *init)
 {
-    unsigned rotation;
-    unsigned seek      = TimeToSeek(newSector, &rotation);
-    unsigned timeAfter = stats->totalTicks + seek + rotation;
+    ASSERT(vector != nullptr);
+    ASSERT(last != nullptr);
+    ASSERT(init != nullptr);
+
+    unsigned long when = stats->totalTicks;
+    for (unsigned i = 0; i < count; i++) {
+        unsigned newSector = vector[i].sector;
+        unsigned rotation;
+        unsigned seek      = TimeToSeek(*last, newSector, when, &rotation);
+        unsigned timeAfter = when + seek + rotation;
+        unsigned latency;
 
 #ifndef NOTRACKBUF  // Turn this on if you do not want the track buffer
                     // stuff.
-    // Check if track buffer applies.
-    if (!writing && seek == 0
-        && (timeAfter - bufferInit) / ROTATION_TIME
-           > ModuloDiff(newSector, bufferInit / ROTATION_TIME)) {
-        DEBUG('d', "Request latency = %u\n", ROTATION_TIME);
-        return ROTATION_TIME;
-          // Time to transfer sector from the track buffer.
-    }
+        // Check if track buffer applies.
+        if (!writing && seek == 0
+            && (timeAfter - *init) / ROTATION_TIME
+               > ModuloDiff(newSector, *init / ROTATION_TIME)) {
+            latency = ROTATION_TIME;
+              // Time to transfer sector from the track buffer.
+        } else
 #endif
-
-    rotation += ModuloDiff(newSector, timeAfter / ROTATION_TIME)
-                * ROTATION_TIME;
-
-    DEBUG('d', "Request latency = %u\n", seek + rotation + ROTATION_TIME);
-    return seek + rotation + ROTATION_TIME;
-}
-
-/// Keep track of the most recently requested sector.  So we can know what is
-/// in the track buffer.
-void
-Disk::UpdateLast(unsigned newSector)
-{
-    unsigned rotate;
-    unsigned seek = TimeToSeek(newSector, &rotate);
-
-    if (seek != 0) {
-        bufferInit = stats->totalTicks + seek + rotate;
+        {
+            rotation += ModuloDiff(newSector, timeAfter / ROTATION_TIME)
+                        * ROTATION_TIME;
+            latency = seek + rotation + ROTATION_TIME;
+        }
+
+        if (seek != 0) {
+            *init = timeAfter;
+        }
+        *last = newSector;
+        when += latency;
     }
-    lastSector = newSector;
-    DEBUG('d', "Updating last sector = %u, %u\n", lastSector, bufferInit);
+    return when - stats->totalTicks;
 }
@@ -1,8 +1,8 @@
 /// Data structures to emulate a physical disk.
 ///
 /// A physical disk can accept (one at a time) requests to read/write a disk
-/// sector; when the request is satisfied, the CPU gets an interrupt, and the
-/// next request can be sent to the disk.
+/// sector, or a list of them; when the request is satisfied, the CPU gets an
+/// interrupt, and the next request can be sent to the disk.
 ///
 /// Disk contents are preserved across machine crashes, but if a file system
 /// operation (eg, create a file) is in progress when the system shuts down,
@@ -19,6 +19,7 @@
 #define NACHOS_MACHINE_DISK__HH
 
 
+#include "geometry.hh"
 #include "lib/utility.hh"
 
 
@@ -50,13 +51,23 @@
 ///
 /// The track buffer simulation can be disabled by compiling with
 /// `-DNOTRACKBUF`.
+///
+/// A request can also carry a list of sectors (scatter/gather), which are
+/// transferred one after the other as the head gets to them, with a single
+/// interrupt at the end.  A run of consecutive sectors costs one seek, and
+/// then just the time for them to rotate under the head.
+///
+/// The number of tracks and of sectors per track can be chosen at startup;
+/// see `geometry.hh`.
 
 const unsigned SECTOR_SIZE = 128;       ///< Number of bytes per disk sector.
-const unsigned SECTORS_PER_TRACK = 32;  ///< Number of sectors per disk
-                                        ///< track.
-const unsigned NUM_TRACKS = 32;         ///< Number of tracks per disk.
-const unsigned NUM_SECTORS = SECTORS_PER_TRACK * NUM_TRACKS;
-  ///< Total # of sectors per disk.
+
+/// One sector of a scatter/gather request, and the memory its contents are
+/// read into or written from.
+struct DiskVector {
+    unsigned sector;
+    char *data;
+};
 
 class Disk {
 public:
@@ -74,6 +85,12 @@ public:
     void ReadRequest(unsigned sectorNumber, char *data);
     void WriteRequest(unsigned sectorNumber, const char *data);
 
+    /// Read/write the `count` sectors in `vector`, in that order, as a
+    /// single request.
+
+    void ReadRequest(const DiskVector *vector, unsigned count);
+    void WriteRequest(const DiskVector *vector, unsigned count);
+
     /// Interrupt handler, invoked when disk request finishes.
     void HandleInterrupt();
 
@@ -82,6 +99,10 @@ public:
     ///     (seek + rotational delay + transfer)
     int ComputeLatency(unsigned newSector, bool writing);
 
+    /// Return how long a request for the sectors in `vector` will take.
+    int ComputeLatency(const DiskVector *vector, unsigned count,
+                       bool writing);
+
 private:
     int fileno;  ///< UNIX file number for simulated disk.
     VoidFunctionPtr handler;  ///< Interrupt handler, to be invoked when any
@@ -92,13 +113,23 @@ private:
     int bufferInit;  ///< When the track buffer started being loaded.
                      // being loaded
 
-    /// Time to get to the new track.
-    unsigned TimeToSeek(unsigned newSector, unsigned *rotate);
+    /// Start a request for the sectors in `vector`.
+    void Request(const DiskVector *vector, unsigned count, bool writing);
+
+    /// Time to get from the track of sector `from` to the new track,
+    /// starting at time `when`.
+    unsigned TimeToSeek(unsigned from, unsigned newSector,
+                        unsigned long when, unsigned *rotate);
 
     /// Number of sectors between `to` and `from`.
     unsigned ModuloDiff(unsigned to, unsigned from);
 
-    void UpdateLast(unsigned newSector);
+    /// Return how long transferring the sectors in `vector` takes, with the
+    /// head starting at sector `*last` and the track buffer loaded since
+    /// `*init`.  Leave there where the head and the track buffer will be
+    /// once done.
+    unsigned Follow(const DiskVector *vector, unsigned count, bool writing,
+                    unsigned *last, int *init);
 };
 
 
@@ -0,0 +1,57 @@
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "geometry.hh"
+#include "disk.hh"
+#include "mmu.hh"
+
+
+unsigned NUM_PHYS_PAGES = DEFAULT_NUM_PHYS_PAGES;
+unsigned MEMORY_SIZE    = DEFAULT_NUM_PHYS_PAGES * PAGE_SIZE;
+unsigned TLB_SIZE       = DEFAULT_TLB_SIZE;
+unsigned TLB_WAYS       = DEFAULT_TLB_SIZE;
+
+unsigned SECTORS_PER_TRACK = DEFAULT_SECTORS_PER_TRACK;
+unsigned NUM_TRACKS        = DEFAULT_NUM_TRACKS;
+unsigned NUM_SECTORS       = DEFAULT_SECTORS_PER_TRACK * DEFAULT_NUM_TRACKS;
+
+bool
+IsValidTlbGeometry(unsigned tlbSize, unsigned tlbWays)
+{
+    if (tlbWays == 0) {
+        tlbWays = tlbSize;
+    }
+    // A single instruction may need both the page it is fetched from and
+    // the one it accesses; with one way they could keep evicting each
+    // other.
+    return tlbWays >= 2 && tlbSize % tlbWays == 0;
+}
+
+void
+SetMemoryGeometry(unsigned numPhysPages, unsigned tlbSize, unsigned tlbWays)
+{
+    ASSERT(numPhysPages > 0);
+    ASSERT(IsValidTlbGeometry(tlbSize, tlbWays));
+
+    if (tlbWays == 0) {
+        tlbWays = tlbSize;
+    }
+
+    NUM_PHYS_PAGES = numPhysPages;
+    MEMORY_SIZE    = numPhysPages * PAGE_SIZE;
+    TLB_SIZE       = tlbSize;
+    TLB_WAYS       = tlbWays;
+}
+
+void
+SetDiskGeometry(unsigned numTracks, unsigned sectorsPerTrack)
+{
+    ASSERT(numTracks > 0);
+    ASSERT(sectorsPerTrack > 0);
+
+    NUM_TRACKS        = numTracks;
+    SECTORS_PER_TRACK = sectorsPerTrack;
+    NUM_SECTORS       = numTracks * sectorsPerTrack;
+}
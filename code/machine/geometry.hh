@@ -0,0 +1,54 @@
+/// Sizes of the simulated hardware that can be chosen at startup.
+///
+/// The amount of physical memory, the number of TLB entries and the shape
+/// of the disk used to be compile-time constants.  They are now variables,
+/// still named like constants: they start with the values below, and
+/// `Initialize` may change them according to the command line, before any
+/// device is created.  They must not change afterwards.
+///
+/// The page and sector sizes are still fixed; see `mmu.hh` and `disk.hh`.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_GEOMETRY__HH
+#define NACHOS_MACHINE_GEOMETRY__HH
+
+
+const unsigned DEFAULT_NUM_PHYS_PAGES = 4;
+const unsigned DEFAULT_TLB_SIZE = 4;
+const unsigned DEFAULT_SECTORS_PER_TRACK = 32;
+const unsigned DEFAULT_NUM_TRACKS = 32;
+
+extern unsigned NUM_PHYS_PAGES;  ///< Number of physical page frames.
+extern unsigned MEMORY_SIZE;     ///< `NUM_PHYS_PAGES * PAGE_SIZE`.
+
+/// Number of entries in the TLB, if one is present.
+///
+/// If there is a TLB, it will be small compared to page tables.
+extern unsigned TLB_SIZE;
+
+/// Number of entries in each set of the TLB.  The TLB is fully associative
+/// by default.
+extern unsigned TLB_WAYS;
+
+extern unsigned SECTORS_PER_TRACK;  ///< Number of sectors per disk track.
+extern unsigned NUM_TRACKS;         ///< Number of tracks per disk.
+extern unsigned NUM_SECTORS;        ///< Total # of sectors per disk.
+
+/// Can a TLB of `tlbSize` entries be split in sets of `tlbWays` (0 for a
+/// fully associative TLB)?
+bool IsValidTlbGeometry(unsigned tlbSize, unsigned tlbWays);
+
+/// Set the size of main memory to `numPhysPages` frames, and that of the
+/// TLB to `tlbSize` entries, in sets of `tlbWays` (0 for a fully
+/// associative TLB).  Sets need at least two ways.
+void SetMemoryGeometry(unsigned numPhysPages, unsigned tlbSize,
+                       unsigned tlbWays);
+
+/// Set the disk to have `numTracks` tracks of `sectorsPerTrack` sectors.
+void SetDiskGeometry(unsigned numTracks, unsigned sectorsPerTrack);
+
+
+#endif
@@ -0,0 +1,101 @@
+/// Routines to manage the cache of decoded instructions.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "instruction_cache.hh"
+#include "lib/utility.hh"
+
+
+/// Initialize the cache, with every word marked as not decoded.
+///
+/// * `nframes` is the number of physical frames in main memory.
+/// * `frameSize` is the size of a frame in bytes.
+InstructionCache::InstructionCache(unsigned nframes, unsigned frameSize)
+{
+    ASSERT(nframes > 0);
+    ASSERT(frameSize % 4 == 0);
+
+    numFrames     = nframes;
+    wordsPerFrame = frameSize / 4;
+    decoded       = new Instruction [numFrames * wordsPerFrame];
+    valid         = new bool [numFrames * wordsPerFrame];
+    frameUsed     = new bool [numFrames];
+    generation    = new unsigned [numFrames];
+
+    for (unsigned i = 0; i < numFrames * wordsPerFrame; i++) {
+        valid[i] = false;
+    }
+    for (unsigned i = 0; i < numFrames; i++) {
+        frameUsed[i]  = false;
+        generation[i] = 0;
+    }
+}
+
+InstructionCache::~InstructionCache()
+{
+    delete [] decoded;
+    delete [] valid;
+    delete [] frameUsed;
+    delete [] generation;
+}
+
+const Instruction *
+InstructionCache::Lookup(unsigned physAddr) const
+{
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    return valid[word] ? &decoded[word] : nullptr;
+}
+
+const Instruction *
+InstructionCache::Insert(unsigned physAddr, unsigned value)
+{
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    Instruction *instr = &decoded[word];
+    instr->value = value;
+    instr->Decode();
+    valid[word] = true;
+    frameUsed[word / wordsPerFrame] = true;
+    return instr;
+}
+
+void
+InstructionCache::InvalidateWord(unsigned physAddr)
+{
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    if (valid[word]) {
+        valid[word] = false;
+        generation[word / wordsPerFrame]++;
+    }
+}
+
+void
+InstructionCache::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    if (!frameUsed[frame]) {
+        return;
+    }
+    for (unsigned i = 0; i < wordsPerFrame; i++) {
+        valid[frame * wordsPerFrame + i] = false;
+    }
+    frameUsed[frame] = false;
+    generation[frame]++;
+}
+
+unsigned
+InstructionCache::GetGeneration(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+
+    return generation[frame];
+}
@@ -0,0 +1,74 @@
+/// Data structures to keep decoded user instructions around.
+///
+/// Every instruction executed by the simulator has to be fetched from
+/// `mainMemory` and decoded.  Since user programs spend most of their time in
+/// loops, the same words get decoded over and over again.  This cache keeps
+/// a decoded copy of every word of physical memory that has been executed,
+/// so that it is only decoded once while it stays resident.
+///
+/// The cache is indexed by physical address.  Whenever the contents of a
+/// physical word change, the decoded copy has to be thrown away: stores
+/// done through the MMU invalidate the word they touch, and the kernel must
+/// invalidate a whole frame whenever it gives the frame to another page.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_INSTRUCTIONCACHE__HH
+#define NACHOS_MACHINE_INSTRUCTIONCACHE__HH
+
+
+#include "instruction.hh"
+
+
+class InstructionCache {
+public:
+
+    /// Initialize an empty cache covering `nframes` physical frames of
+    /// `frameSize` bytes each.
+    InstructionCache(unsigned nframes, unsigned frameSize);
+
+    /// De-allocate the cache.
+    ~InstructionCache();
+
+    /// Return the decoded instruction stored at `physAddr`, or null if the
+    /// word has not been decoded since it was last invalidated.
+    const Instruction *Lookup(unsigned physAddr) const;
+
+    /// Decode the raw word `value`, found at `physAddr`, and remember it.
+    const Instruction *Insert(unsigned physAddr, unsigned value);
+
+    /// Forget the decoded copy of the word containing `physAddr`.
+    void InvalidateWord(unsigned physAddr);
+
+    /// Forget every decoded word of physical frame `frame`.
+    void InvalidateFrame(unsigned frame);
+
+    /// Return a counter that changes every time some decoded word of
+    /// `frame` is invalidated.
+    ///
+    /// Clients that keep information derived from the decoded words (such
+    /// as translated basic blocks) can compare it to detect stale data.
+    unsigned GetGeneration(unsigned frame) const;
+
+private:
+    unsigned numFrames;
+    unsigned wordsPerFrame;
+
+    /// One decoded instruction per word of physical memory.
+    Instruction *decoded;
+
+    /// Whether the corresponding entry of `decoded` is up to date.
+    bool *valid;
+
+    /// Whether any word of a frame has been decoded since the frame was
+    /// last invalidated.  Lets `InvalidateFrame` skip data-only frames.
+    bool *frameUsed;
+
+    /// Invalidation counter of every frame.
+    unsigned *generation;
+};
+
+
+#endif
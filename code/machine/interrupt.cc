@@ -60,10 +60,222 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
     ASSERT(func != nullptr);
     ASSERT(IsIntType(kind));
 
-    handler = func;
-    arg     = param;
-    when    = time;
-    type    = kind;
+    handler  = func;
+    arg      = param;
+    when     = time;
+    type     = kind;
+    sequence = 0;
+}
+
+PendingQueue::PendingQueue()
+{
+    capacity     = 16;
+    heap         = new PendingInterrupt * [capacity];
+    spare        = new PendingInterrupt * [capacity];
+    size         = 0;
+    spareCount   = 0;
+    allocated    = 0;
+    nextSequence = 0;
+}
+
+PendingQueue::~PendingQueue()
+{
+    for (unsigned i = 0; i < size; i++) {
+        delete heap[i];
+    }
+    for (unsigned i = 0; i < spareCount; i++) {
+        delete spare[i];
+    }
+    delete [] heap;
+    delete [] spare;
+}
+
+PendingInterrupt *
+PendingQueue::Allocate(VoidFunctionPtr handler, void *arg,
+                       unsigned long when, IntType type)
+{
+    if (spareCount == 0) {
+        if (allocated == capacity) {
+            PendingInterrupt **oldHeap = heap;
+            delete [] spare;
+            capacity *= 2;
+            heap  = new PendingInterrupt * [capacity];
+            spare = new PendingInterrupt * [capacity];
+            for (unsigned i = 0; i < size; i++) {
+                heap[i] = oldHeap[i];
+            }
+            delete [] oldHeap;
+        }
+        allocated++;
+        return new PendingInterrupt(handler, arg, when, type);
+    }
+
+    PendingInterrupt *pend = spare[--spareCount];
+    pend->handler = handler;
+    pend->arg     = arg;
+    pend->when    = when;
+    pend->type    = type;
+    return pend;
+}
+
+void
+PendingQueue::Release(PendingInterrupt *pend)
+{
+    ASSERT(pend != nullptr);
+    ASSERT(spareCount < capacity);
+
+    spare[spareCount++] = pend;
+}
+
+void
+PendingQueue::Insert(PendingInterrupt *pend)
+{
+    ASSERT(pend != nullptr);
+    ASSERT(size < capacity);
+
+    pend->sequence = nextSequence++;
+    heap[size] = pend;
+    SiftUp(size++);
+}
+
+PendingInterrupt *
+PendingQueue::Peek() const
+{
+    return size == 0 ? nullptr : heap[0];
+}
+
+PendingInterrupt *
+PendingQueue::Pop()
+{
+    if (size == 0) {
+        return nullptr;
+    }
+    PendingInterrupt *first = heap[0];
+    heap[0] = heap[--size];
+    if (size > 0) {
+        SiftDown(0);
+    }
+    return first;
+}
+
+void
+PendingQueue::Requeue()
+{
+    ASSERT(size > 0);
+
+    heap[0]->sequence = nextSequence++;
+    SiftDown(0);
+}
+
+/// Requeuing only reorders the interrupts due at the same time as the first
+/// one, so it is enough to requeue `times` modulo their number.
+void
+PendingQueue::Rotate(unsigned long times)
+{
+    if (times == 0 || size < 2) {
+        return;
+    }
+    unsigned ties = CountDueAt(0, heap[0]->when);
+    for (unsigned long i = 0; i < times % ties; i++) {
+        Requeue();
+    }
+}
+
+void
+PendingQueue::Rebase(unsigned long delta)
+{
+    // Interrupts already overdue stay due right away.
+    for (unsigned i = 0; i < size; i++) {
+        PendingInterrupt *e = heap[i];
+        e->when = e->when > delta ? e->when - delta : 0;
+    }
+
+    // Overdue interrupts now tie, and are ordered by when they were
+    // scheduled instead, so restore the heap.
+    for (unsigned i = size / 2; i-- > 0; ) {
+        SiftDown(i);
+    }
+}
+
+/// The heap is not sorted, so go through a sorted copy.  Only used for
+/// debugging.
+void
+PendingQueue::Apply(void (*func)(PendingInterrupt *)) const
+{
+    ASSERT(func != nullptr);
+
+    PendingInterrupt **sorted = new PendingInterrupt * [size];
+    for (unsigned i = 0; i < size; i++) {
+        unsigned j = i;
+        for (; j > 0 && Before(heap[i], sorted[j - 1]); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = heap[i];
+    }
+    for (unsigned i = 0; i < size; i++) {
+        func(sorted[i]);
+    }
+    delete [] sorted;
+}
+
+unsigned
+PendingQueue::Size() const
+{
+    return size;
+}
+
+bool
+PendingQueue::IsEmpty() const
+{
+    return size == 0;
+}
+
+bool
+PendingQueue::Before(const PendingInterrupt *a, const PendingInterrupt *b)
+{
+    return a->when < b->when
+           || (a->when == b->when && a->sequence < b->sequence);
+}
+
+void
+PendingQueue::SiftUp(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    while (i > 0 && Before(pend, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = pend;
+}
+
+void
+PendingQueue::SiftDown(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && Before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!Before(heap[child], pend)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = pend;
+}
+
+unsigned
+PendingQueue::CountDueAt(unsigned i, unsigned long when) const
+{
+    if (i >= size || heap[i]->when != when) {
+        return 0;  // Nothing below is due any sooner.
+    }
+    return 1 + CountDueAt(2 * i + 1, when) + CountDueAt(2 * i + 2, when);
 }
 
 /// Initialize the simulation of hardware device interrupts.
@@ -72,18 +284,17 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    pending       = new PendingQueue;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
+
+    checkedUserTicks = 0;
 }
 
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
-    }
     delete pending;
 }
 
@@ -143,10 +354,16 @@ Interrupt::Enable()
 /// Two things can cause `OneTick` to be called:
 /// * interrupts are re-enabled;
 /// * a user instruction is executed.
-void
+///
+/// Returns true if some interrupt handler ran (and thus the kernel may have
+/// changed the state of the machine behind the simulator's back).
+bool
 Interrupt::OneTick()
 {
     MachineStatus old = status;
+    bool fired = false;
+
+    CatchUp();
 
     // Advance simulated time.
     if (status == SYSTEM_MODE) {
@@ -156,12 +373,15 @@ Interrupt::OneTick()
         stats->totalTicks += USER_TICK;
         stats->userTicks += USER_TICK;
     }
+    checkedUserTicks = stats->userTicks;
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
-    while (CheckIfDue(false)) {}   // Check for pending interrupts.
+    while (CheckIfDue(false)) {    // Check for pending interrupts.
+        fired = true;
+    }
     ChangeLevel(INT_OFF, INT_ON);  // Re-enable interrupts.
     if (yieldOnReturn) {           // If the timer device handler asked for a
                                    // context switch, ok to do it now.
@@ -170,6 +390,43 @@ Interrupt::OneTick()
         currentThread->Yield();
         status = old;
     }
+    return fired;
+}
+
+/// Until the returned time, `OneTick` would find no interrupt due, so user
+/// instructions can be run in a batch, calling `UserTick` instead.
+///
+/// `CheckIfDue` would have only put the earliest pending interrupt back in
+/// the queue, so `CatchUp` does that for every call skipped before the
+/// queue is next used.
+unsigned long
+Interrupt::NextEventTick()
+{
+    if (status != USER_MODE || level != INT_ON || yieldOnReturn
+          || debug.IsEnabled('i')) {
+        return stats->totalTicks;
+    }
+    if (pending->IsEmpty()) {
+        return ULONG_MAX;
+    }
+    return pending->Peek()->when;
+}
+
+/// Every `USER_TICK` of user time added without `OneTick`, by `UserTick` or
+/// by compiled code, stands for a call to `CheckIfDue` that found nothing
+/// due.
+void
+Interrupt::CatchUp()
+{
+    pending->Rotate((stats->userTicks - checkedUserTicks) / USER_TICK);
+    checkedUserTicks = stats->userTicks;
+}
+
+void
+Interrupt::UserTick()
+{
+    stats->totalTicks += USER_TICK;
+    stats->userTicks += USER_TICK;
 }
 
 /// Called from within an interrupt handler, to cause a context switch (for
@@ -197,6 +454,7 @@ void
 Interrupt::Idle()
 {
     DEBUG('i', "Machine idling; checking for interrupts.\n");
+    CatchUp();
     status = IDLE_MODE;
     if (CheckIfDue(true)) {           // Check for any pending interrupts.
         while (CheckIfDue(false)) {}  // Check for any other pending
@@ -223,6 +481,11 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+#ifdef FILESYS
+    // Write back what the buffer cache still holds while every kernel
+    // object is alive, and before the statistics are printed.
+    synchDisk->Flush();
+#endif
     stats->Print();
     Cleanup();  // Never returns.
 }
@@ -237,19 +500,9 @@ Interrupt::Halt()
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
-        DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
-    }
-
-    delete oldPending;
+    DEBUG('x', "Interrupts re-scheduled %lu ticks earlier.\n",
+          stats->totalTicks);
+    pending->Rebase(stats->totalTicks);
     stats->totalTicks = 0;
     stats->tickResets += 1;
 }
@@ -276,6 +529,8 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     ASSERT(fromNow > 0);
     ASSERT(IsIntType(type));
 
+    CatchUp();
+
 #ifdef DFS_TICKS_FIX
     if (UINT_MAX - stats->totalTicks < fromNow) {
         DEBUG('x', "WARNING: total tick count is too large"
@@ -288,13 +543,12 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
 #endif
 
     unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+    PendingInterrupt *toOccur = pending->Allocate(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur);
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -316,26 +570,27 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
+    PendingInterrupt *toOccur = pending->Peek();
 
     if (toOccur == nullptr) {  // No pending interrupts.
         return false;
     }
+    when = toOccur->when;
 
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
     } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+        pending->Requeue();
         return false;
     }
 
     // Check if there is nothing more to do, and if so, quit.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+          && pending->Size() == 1) {
         return false;
     }
+    pending->Pop();
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
@@ -350,7 +605,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*toOccur->handler)(toOccur->arg);  // Call the interrupt handler.
     status = old;  // Restore the machine status.
     inHandler = false;
-    delete toOccur;
+    pending->Release(toOccur);
     return true;
 }
 
@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/utility.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -87,6 +87,77 @@ public:
     void *arg;  ///< The argument to the function.
     unsigned long when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    unsigned long sequence;  ///< Order among interrupts due at the same
+                             ///< time.
+};
+
+/// The interrupts scheduled to occur in the future, in the order they fire.
+///
+/// Kept as a binary heap ordered by `when`, and by `sequence` among
+/// interrupts due at the same time, so they fire in the order they were
+/// scheduled.  Interrupt objects are recycled instead of deleted, since
+/// devices reschedule themselves all the time.
+class PendingQueue {
+public:
+
+    /// Initialize an empty queue.
+    PendingQueue();
+
+    /// De-allocate the queue, and every interrupt object it holds.
+    ~PendingQueue();
+
+    /// Return a new interrupt object, not yet in the queue.
+    PendingInterrupt *Allocate(VoidFunctionPtr handler, void *arg,
+                               unsigned long when, IntType type);
+
+    /// Give back an interrupt object, once it is out of the queue.
+    void Release(PendingInterrupt *pend);
+
+    /// Put `pend` in the queue, after every interrupt due at the same time.
+    void Insert(PendingInterrupt *pend);
+
+    /// Return the next interrupt to fire, without removing it.
+    PendingInterrupt *Peek() const;
+
+    /// Remove the next interrupt to fire and return it.
+    PendingInterrupt *Pop();
+
+    /// Move the next interrupt to fire behind every other interrupt due at
+    /// the same time, just as taking it out and inserting it again would.
+    void Requeue();
+
+    /// Do `Requeue` `times` times.
+    void Rotate(unsigned long times);
+
+    /// Subtract `delta` from the time of every interrupt, stopping at 0.
+    void Rebase(unsigned long delta);
+
+    /// Apply `func` to every interrupt, in the order they fire.
+    void Apply(void (*func)(PendingInterrupt *)) const;
+
+    unsigned Size() const;
+
+    bool IsEmpty() const;
+
+private:
+
+    /// Whether `a` fires before `b`.
+    static bool Before(const PendingInterrupt *a, const PendingInterrupt *b);
+
+    void SiftUp(unsigned i);
+    void SiftDown(unsigned i);
+
+    /// Count the interrupts in the subtree at `i` due at time `when`.
+    unsigned CountDueAt(unsigned i, unsigned long when) const;
+
+    PendingInterrupt **heap;   ///< The queue itself.
+    PendingInterrupt **spare;  ///< Interrupt objects ready to be reused.
+    unsigned size;        ///< Interrupts in `heap`.
+    unsigned spareCount;  ///< Objects in `spare`.
+    unsigned capacity;    ///< Room in both arrays, and maximum number of
+                          ///< interrupt objects allocated.
+    unsigned allocated;   ///< Interrupt objects allocated so far.
+    unsigned long nextSequence;
 };
 
 /// The following class defines the data structures for the simulation
@@ -143,12 +214,29 @@ public:
                   unsigned long when, IntType type);
 
     /// Advance simulated time.
-    void OneTick();
+    ///
+    /// Return true if any interrupt handler was invoked.
+    bool OneTick();
+
+    /// Return the time at which `OneTick` may next have something to do
+    /// besides advancing the clock: the time of the earliest pending
+    /// interrupt, or the current time if a context switch is pending or
+    /// the machine is not running user code with interrupts enabled.
+    ///
+    /// It stays valid until the kernel runs again, that is, until some
+    /// exception or interrupt handler is invoked.
+    unsigned long NextEventTick();
+
+    /// Advance simulated time by one user instruction.
+    ///
+    /// Only to be used while `stats->totalTicks + USER_TICK` is below
+    /// `NextEventTick`, where it has the same effect as `OneTick`.
+    void UserTick();
 
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    PendingQueue *pending;  ///< The interrupts scheduled to occur in the
+                            ///< future.
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
@@ -159,6 +247,13 @@ private:
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
+    /// `userTicks` as of the last call to `CheckIfDue`.
+    unsigned long checkedUserTicks;
+
+    /// Bring `pending` up to date with the calls to `CheckIfDue` that
+    /// `UserTick` skipped.
+    void CatchUp();
+
     /// SetLevel, without advancing the simulated time.
     void ChangeLevel(IntStatus old,
                      IntStatus now);
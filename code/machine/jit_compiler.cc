@@ -0,0 +1,647 @@
+/// Routines to compile basic blocks into x86-64 code.
+///
+/// Generated code keeps a pointer to the register file in `rbx` and uses
+/// `eax`, `ecx` and `edx` as scratch registers.  Each compiled run looks
+/// like this:
+///
+///     epilogue:  pop rbx; ret
+///     body:      <instruction i>   ; computes, advances PC/NEXT_PC/PREV_PC
+///                tick              ; stop if an interrupt handler ran
+///                <instruction i+1>
+///                ...
+///                return end of the run
+///     entries:   push rbx; mov rbx, registers; jmp <instruction i>
+///                push rbx; mov rbx, registers; jmp <instruction i+1>
+///                ...
+///
+/// so that it can be entered at any instruction of the run.
+///
+/// Advancing time is done inline while the clock is below the event horizon
+/// kept by the block engine (see `Interrupt::NextEventTick`); only at the
+/// horizon does the code call back into `JitTick`.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "jit_compiler.hh"
+#include "block_engine.hh"
+#include "machine.hh"
+#include "system_dep.hh"
+#include "threads/system.hh"
+
+#include <stdint.h>
+#include <string.h>
+
+
+#ifdef HOST_x86_64
+
+/// Advance simulated time after an instruction run by compiled code, just
+/// as `Machine::Run` does after fetching and executing it, once the clock
+/// reaches `*horizon`.  Then move the horizon along.
+static unsigned
+JitTick(unsigned long *horizon)
+{
+    stats->numAccessMemory++;
+    stats->numHits++;
+    bool fired = interrupt->OneTick();
+    *horizon = interrupt->NextEventTick();
+    return fired;
+}
+
+/// Host registers used by generated code; `EDI` only to pass arguments.
+enum { EAX = 0, ECX = 1, EDX = 2, EDI = 7 };
+
+/// Condition codes, as encoded in `setcc`, `cmovcc` and `jcc`.
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC,
+       CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+/// Opcodes of the two-register ALU instructions (`op r/m32, r32`).
+enum { ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21, ALU_SUB = 0x29,
+       ALU_XOR = 0x31, ALU_CMP = 0x39, ALU_TEST = 0x85 };
+
+/// Opcode extensions of the immediate ALU and shift instructions.
+enum { EXT_ADD = 0, EXT_OR = 1, EXT_AND = 4, EXT_XOR = 6, EXT_CMP = 7,
+       EXT_SHL = 4, EXT_SAR = 7 };
+
+/// Append x86-64 machine code to a buffer.
+class Emitter {
+public:
+    Emitter(char *buffer, unsigned size)
+    {
+        start = buffer;
+        pos   = 0;
+        limit = size;
+    }
+
+    bool Overflowed() const { return pos > limit; }
+    unsigned Size() const { return pos; }
+    char *Here() const { return start + pos; }
+
+    void Byte(unsigned b)
+    {
+        if (pos < limit) {
+            start[pos] = (char) b;
+        }
+        pos++;
+    }
+
+    void Word(unsigned w)
+    {
+        for (unsigned i = 0; i < 4; i++) {
+            Byte(w >> (8 * i) & 0xFF);
+        }
+    }
+
+    void Quad(uint64_t q)
+    {
+        Word((unsigned) q);
+        Word((unsigned) (q >> 32));
+    }
+
+    /// `mov host, [rbx + 4 * reg]`.
+    void Load(unsigned host, unsigned reg)
+    {
+        Byte(0x8B);
+        Byte(0x80 | host << 3 | 3);
+        Word(4 * reg);
+    }
+
+    /// `mov [rbx + 4 * reg], host`.
+    void Store(unsigned reg, unsigned host)
+    {
+        Byte(0x89);
+        Byte(0x80 | host << 3 | 3);
+        Word(4 * reg);
+    }
+
+    /// `mov host, imm32`.
+    void MovImm(unsigned host, unsigned imm)
+    {
+        Byte(0xB8 + host);
+        Word(imm);
+    }
+
+    /// `op dst, src`.
+    void AluReg(unsigned op, unsigned dst, unsigned src)
+    {
+        Byte(op);
+        Byte(0xC0 | src << 3 | dst);
+    }
+
+    /// `op dst, imm32`.
+    void AluImm(unsigned ext, unsigned dst, unsigned imm)
+    {
+        Byte(0x81);
+        Byte(0xC0 | ext << 3 | dst);
+        Word(imm);
+    }
+
+    /// `shl/sar dst, imm8`.
+    void ShiftImm(unsigned ext, unsigned dst, unsigned amount)
+    {
+        Byte(0xC1);
+        Byte(0xC0 | ext << 3 | dst);
+        Byte(amount);
+    }
+
+    /// `shl/sar dst, cl`.
+    void ShiftCl(unsigned ext, unsigned dst)
+    {
+        Byte(0xD3);
+        Byte(0xC0 | ext << 3 | dst);
+    }
+
+    /// `not dst`.
+    void Not(unsigned dst)
+    {
+        Byte(0xF7);
+        Byte(0xD0 | dst);
+    }
+
+    /// `setcc al; movzx eax, al`.
+    void SetEax(unsigned cc)
+    {
+        Byte(0x0F); Byte(0x90 | cc); Byte(0xC0);
+        Byte(0x0F); Byte(0xB6); Byte(0xC0);
+    }
+
+    /// `cmovcc dst, src`.
+    void Cmov(unsigned cc, unsigned dst, unsigned src)
+    {
+        Byte(0x0F); Byte(0x40 | cc);
+        Byte(0xC0 | dst << 3 | src);
+    }
+
+    /// `jmp target`.
+    void Jump(const char *target)
+    {
+        Byte(0xE9);
+        Word((unsigned) (target - (Here() + 4)));
+    }
+
+    /// `mov rax, func; call rax`.
+    void Call(uintptr_t func)
+    {
+        Byte(0x48); Byte(0xB8); Quad(func);
+        Byte(0xFF); Byte(0xD0);
+    }
+
+    /// `mov rbx, imm64`.
+    void MovRbx(uintptr_t value)
+    {
+        Byte(0x48); Byte(0xBB); Quad(value);
+    }
+
+    /// `mov host64, imm64`.
+    void MovImm64(unsigned host, uint64_t value)
+    {
+        Byte(0x48); Byte(0xB8 + host); Quad(value);
+    }
+
+    /// `mov dst64, [addr64]`.
+    void LoadQuad(unsigned dst, unsigned addr)
+    {
+        Byte(0x48); Byte(0x8B); Byte(dst << 3 | addr);
+    }
+
+    /// `mov [addr64], src64`.
+    void StoreQuad(unsigned addr, unsigned src)
+    {
+        Byte(0x48); Byte(0x89); Byte(src << 3 | addr);
+    }
+
+    /// `cmp host64, [addr64]`.
+    void CmpQuad(unsigned host, unsigned addr)
+    {
+        Byte(0x48); Byte(0x3B); Byte(host << 3 | addr);
+    }
+
+    /// `add host64, imm8`.
+    void AddQuadImm(unsigned host, unsigned imm)
+    {
+        Byte(0x48); Byte(0x83); Byte(0xC0 | host); Byte(imm);
+    }
+
+    /// `add qword [addr64], imm8`.
+    void AddQuadMem(unsigned addr, unsigned imm)
+    {
+        Byte(0x48); Byte(0x83); Byte(addr); Byte(imm);
+    }
+
+    /// `jcc rel8` (or `jmp rel8` if `cc` is `JMP_SHORT`) to a label bound
+    /// later with `Bind`.  Returns the label.
+    unsigned JumpShort(unsigned cc)
+    {
+        Byte(cc == JMP_SHORT ? 0xEB : 0x70 | cc);
+        Byte(0);
+        return pos;
+    }
+
+    /// Make the jump returned by `JumpShort` land here.
+    void Bind(unsigned label)
+    {
+        ASSERT(pos - label < 0x80);
+        if (label <= limit) {
+            start[label - 1] = (char) (pos - label);
+        }
+    }
+
+    static const unsigned JMP_SHORT = ~0U;
+
+private:
+    char *start;
+    unsigned pos;
+    unsigned limit;
+};
+
+/// Emit the program counter update at the end of an instruction, with the
+/// new `NEXT_PC` in `pcAfter`, or `NEXT_PC + 4` if `sequential`.
+static void
+EmitAdvance(Emitter *e, bool sequential, unsigned pcAfter = EAX)
+{
+    e->Load(ECX, PC_REG);
+    e->Store(PREV_PC_REG, ECX);
+    e->Load(EDX, NEXT_PC_REG);
+    e->Store(PC_REG, EDX);
+    if (sequential) {
+        e->AluImm(EXT_ADD, EDX, 4);
+        e->Store(NEXT_PC_REG, EDX);
+    } else {
+        e->Store(NEXT_PC_REG, pcAfter);
+    }
+}
+
+/// Store `eax` into MIPS register `reg`; writes to register 0 are dropped,
+/// just as `DelayedLoad` would undo them.
+static void
+EmitResult(Emitter *e, unsigned reg)
+{
+    if (reg != 0) {
+        e->Store(reg, EAX);
+    }
+}
+
+/// Emit a conditional branch: `NEXT_PC` advances by the branch offset if
+/// `cc` holds after the comparison already emitted, and by 4 otherwise.
+static void
+EmitBranch(Emitter *e, unsigned cc, int extra)
+{
+    e->MovImm(EAX, 4);
+    e->MovImm(ECX, IndexToAddr(extra));
+    e->Cmov(cc, EAX, ECX);
+    e->Load(ECX, PC_REG);
+    e->Store(PREV_PC_REG, ECX);
+    e->Load(EDX, NEXT_PC_REG);
+    e->Store(PC_REG, EDX);
+    e->AluReg(ALU_ADD, EDX, EAX);
+    e->Store(NEXT_PC_REG, EDX);
+}
+
+/// Emit the time advance after instruction `i` of a run: inline while below
+/// `*horizon`, through `JitTick` otherwise, returning to the block engine
+/// if an interrupt handler ran.
+static void
+EmitTick(Emitter *e, unsigned long *horizon, unsigned i, const char *epilogue)
+{
+    e->MovImm64(EAX, (uintptr_t) &stats->totalTicks);
+    e->LoadQuad(ECX, EAX);
+    e->AddQuadImm(ECX, USER_TICK);
+    e->MovImm64(EDX, (uintptr_t) horizon);
+    e->CmpQuad(ECX, EDX);
+    unsigned slow = e->JumpShort(CC_AE);
+    e->StoreQuad(EAX, ECX);
+    e->MovImm64(EAX, (uintptr_t) &stats->userTicks);
+    e->AddQuadMem(EAX, USER_TICK);
+    e->MovImm64(EAX, (uintptr_t) &stats->numAccessMemory);
+    e->AddQuadMem(EAX, 1);
+    e->MovImm64(EAX, (uintptr_t) &stats->numHits);
+    e->AddQuadMem(EAX, 1);
+    unsigned done = e->JumpShort(Emitter::JMP_SHORT);
+
+    e->Bind(slow);
+    e->MovImm64(EDI, (uintptr_t) horizon);
+    e->Call((uintptr_t) JitTick);
+    e->AluReg(ALU_TEST, EAX, EAX);
+    unsigned quiet = e->JumpShort(CC_E);
+    e->MovImm(EAX, (i + 1) << 1 | 1);
+    e->Jump(epilogue);
+
+    e->Bind(done);
+    e->Bind(quiet);
+}
+
+/// Emit the code for one instruction.  Must agree with the corresponding
+/// handler in `block_engine.cc`.
+static void
+EmitInstruction(Emitter *e, const Instruction *instr)
+{
+    switch (instr->opCode) {
+        case OP_ADDIU:
+            e->Load(EAX, instr->rs);
+            e->AluImm(EXT_ADD, EAX, instr->extra);
+            EmitResult(e, instr->rt);
+            break;
+
+        case OP_ADDU:
+        case OP_SUBU:
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+        case OP_NOR: {
+            unsigned op = instr->opCode == OP_ADDU ? ALU_ADD
+                        : instr->opCode == OP_SUBU ? ALU_SUB
+                        : instr->opCode == OP_AND  ? ALU_AND
+                        : instr->opCode == OP_XOR  ? ALU_XOR
+                        : ALU_OR;
+            e->Load(EAX, instr->rs);
+            e->Load(ECX, instr->rt);
+            e->AluReg(op, EAX, ECX);
+            if (instr->opCode == OP_NOR) {
+                e->Not(EAX);
+            }
+            EmitResult(e, instr->rd);
+            break;
+        }
+
+        case OP_ANDI:
+        case OP_ORI:
+        case OP_XORI: {
+            unsigned ext = instr->opCode == OP_ANDI ? EXT_AND
+                         : instr->opCode == OP_ORI  ? EXT_OR
+                         : EXT_XOR;
+            e->Load(EAX, instr->rs);
+            e->AluImm(ext, EAX, instr->extra & 0xFFFF);
+            EmitResult(e, instr->rt);
+            break;
+        }
+
+        case OP_LUI:
+            e->MovImm(EAX, (unsigned) instr->extra << 16);
+            EmitResult(e, instr->rt);
+            break;
+
+        case OP_SLL:
+        case OP_SRA:
+        case OP_SRL:
+            // `ExecInstruction` shifts right through a signed integer, for
+            // `SRL` too.
+            e->Load(EAX, instr->rt);
+            e->ShiftImm(instr->opCode == OP_SLL ? EXT_SHL : EXT_SAR,
+                        EAX, instr->extra);
+            EmitResult(e, instr->rd);
+            break;
+
+        case OP_SLLV:
+        case OP_SRAV:
+        case OP_SRLV:
+            e->Load(EAX, instr->rt);
+            e->Load(ECX, instr->rs);
+            e->ShiftCl(instr->opCode == OP_SLLV ? EXT_SHL : EXT_SAR, EAX);
+            EmitResult(e, instr->rd);
+            break;
+
+        case OP_SLT:
+        case OP_SLTU:
+            e->Load(EAX, instr->rs);
+            e->Load(ECX, instr->rt);
+            e->AluReg(ALU_CMP, EAX, ECX);
+            e->SetEax(instr->opCode == OP_SLT ? CC_L : CC_B);
+            EmitResult(e, instr->rd);
+            break;
+
+        case OP_SLTI:
+        case OP_SLTIU:
+            e->Load(EAX, instr->rs);
+            e->AluImm(EXT_CMP, EAX, instr->extra);
+            e->SetEax(instr->opCode == OP_SLTI ? CC_L : CC_B);
+            EmitResult(e, instr->rt);
+            break;
+
+        case OP_MFHI:
+        case OP_MFLO:
+            e->Load(EAX, instr->opCode == OP_MFHI ? HI_REG : LO_REG);
+            EmitResult(e, instr->rd);
+            break;
+
+        case OP_MTHI:
+        case OP_MTLO:
+            e->Load(EAX, instr->rs);
+            e->Store(instr->opCode == OP_MTHI ? HI_REG : LO_REG, EAX);
+            break;
+
+        case OP_BEQ:
+        case OP_BNE:
+            e->Load(EAX, instr->rs);
+            e->Load(ECX, instr->rt);
+            e->AluReg(ALU_CMP, EAX, ECX);
+            EmitBranch(e, instr->opCode == OP_BEQ ? CC_E : CC_NE,
+                       instr->extra);
+            return;
+
+        case OP_BGTZ:
+        case OP_BLEZ:
+        case OP_BGEZ:
+        case OP_BLTZ:
+            e->Load(EAX, instr->rs);
+            e->AluImm(EXT_CMP, EAX, 0);
+            EmitBranch(e, instr->opCode == OP_BGTZ ? CC_G
+                        : instr->opCode == OP_BLEZ ? CC_LE
+                        : instr->opCode == OP_BGEZ ? CC_GE
+                        : CC_L, instr->extra);
+            return;
+
+        case OP_J:
+        case OP_JAL:
+            e->Load(EAX, NEXT_PC_REG);
+            e->AluImm(EXT_ADD, EAX, 4);
+            if (instr->opCode == OP_JAL) {
+                e->Store(RET_ADDR_REG, EAX);
+            }
+            e->AluImm(EXT_AND, EAX, 0xF0000000);
+            e->AluImm(EXT_OR, EAX, IndexToAddr(instr->extra));
+            EmitAdvance(e, false);
+            return;
+
+        case OP_JR:
+        case OP_JALR:
+            if (instr->opCode == OP_JALR) {
+                // The link register is written before the target is read,
+                // as in `ExecInstruction`.
+                e->Load(EAX, NEXT_PC_REG);
+                e->AluImm(EXT_ADD, EAX, 4);
+                e->Store(instr->rd, EAX);
+            }
+            e->Load(EAX, instr->rs);
+            if (instr->opCode == OP_JALR && instr->rd == 0) {
+                e->MovImm(ECX, 0);
+                e->Store(0, ECX);
+            }
+            EmitAdvance(e, false);
+            return;
+
+        default:
+            ASSERT(false);
+    }
+    EmitAdvance(e, true);
+}
+
+JitCompiler::JitCompiler(int *regs, unsigned long *eventHorizon)
+{
+    ASSERT(regs != nullptr);
+    ASSERT(eventHorizon != nullptr);
+
+    registers = regs;
+    horizon   = eventHorizon;
+    code      = SystemDep::AllocExecutable(JIT_CODE_SIZE);
+    used      = 0;
+    active    = 0;
+}
+
+JitCompiler::~JitCompiler()
+{
+    if (code != nullptr) {
+        SystemDep::DeallocExecutable(code, JIT_CODE_SIZE);
+    }
+}
+
+bool
+JitCompiler::IsAvailable() const
+{
+    return code != nullptr;
+}
+
+bool
+JitCompiler::CanCompile(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_ADDIU: case OP_ADDU: case OP_SUBU:
+        case OP_AND:   case OP_ANDI: case OP_OR:    case OP_ORI:
+        case OP_XOR:   case OP_XORI: case OP_NOR:   case OP_LUI:
+        case OP_SLL:   case OP_SRA:  case OP_SRL:
+        case OP_SLLV:  case OP_SRAV: case OP_SRLV:
+        case OP_SLT:   case OP_SLTU: case OP_SLTI:  case OP_SLTIU:
+        case OP_MFHI:  case OP_MFLO: case OP_MTHI:  case OP_MTLO:
+        case OP_BEQ:   case OP_BNE:  case OP_BGTZ:  case OP_BLEZ:
+        case OP_BGEZ:  case OP_BLTZ:
+        case OP_J:     case OP_JAL:  case OP_JR:    case OP_JALR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool
+JitCompiler::Compile(Block *block)
+{
+    ASSERT(block != nullptr);
+    ASSERT(IsAvailable());
+
+    Emitter e(code + used, JIT_CODE_SIZE - used);
+    char *epilogue = e.Here();
+    e.Byte(0x5B);  // pop rbx
+    e.Byte(0xC3);  // ret
+
+    char *body[MAX_BLOCK_LENGTH];
+    for (unsigned i = 0; i < block->length; ) {
+        if (!CanCompile(block->entries[i].instr->opCode)) {
+            i++;
+            continue;
+        }
+
+        // Compile the run of instructions starting at `i`.
+        unsigned first = i;
+        for (; i < block->length
+               && CanCompile(block->entries[i].instr->opCode); i++) {
+            body[i] = e.Here();
+            EmitInstruction(&e, block->entries[i].instr);
+            EmitTick(&e, horizon, i, epilogue);
+        }
+        e.MovImm(EAX, i << 1);
+        e.Jump(epilogue);
+
+        for (unsigned j = first; j < i; j++) {
+            block->entries[j].native = (JitCode) e.Here();
+            e.Byte(0x53);  // push rbx
+            e.MovRbx((uintptr_t) registers);
+            e.Jump(body[j]);
+        }
+    }
+
+    if (e.Overflowed()) {
+        for (unsigned i = 0; i < block->length; i++) {
+            block->entries[i].native = nullptr;
+        }
+        return false;
+    }
+    used += e.Size();
+    return true;
+}
+
+unsigned
+JitCompiler::Run(JitCode entry)
+{
+    ASSERT(entry != nullptr);
+
+    active++;
+    unsigned result = entry();
+    active--;
+    return result;
+}
+
+#else
+
+JitCompiler::JitCompiler(int *regs, unsigned long *eventHorizon)
+{
+    registers = regs;
+    horizon   = eventHorizon;
+    code      = nullptr;
+    used      = 0;
+    active    = 0;
+}
+
+JitCompiler::~JitCompiler()
+{}
+
+bool
+JitCompiler::IsAvailable() const
+{
+    return false;
+}
+
+bool
+JitCompiler::CanCompile(unsigned char opCode)
+{
+    return false;
+}
+
+bool
+JitCompiler::Compile(Block *block)
+{
+    return false;
+}
+
+unsigned
+JitCompiler::Run(JitCode entry)
+{
+    ASSERT(false);
+    return 0;
+}
+
+#endif
+
+bool
+JitCompiler::CanFlush() const
+{
+    return active == 0;
+}
+
+void
+JitCompiler::Flush()
+{
+    ASSERT(CanFlush());
+
+    DEBUG('b', "Flushing %u bytes of compiled code\n", used);
+    used = 0;
+}
@@ -0,0 +1,96 @@
+/// Data structures for compiling hot basic blocks into host code.
+///
+/// This is the second tier of the block engine: once a block has been run
+/// `JIT_THRESHOLD` times, the longest runs of register-only instructions in
+/// it (arithmetic, logic, shifts, comparisons, branches and jumps) are
+/// compiled into x86-64 code that works directly on `Machine::registers`.
+/// Loads, stores, system calls, and anything else that may trap keep going
+/// through the block handlers, and hence through `RaiseException`.
+///
+/// Compiled code still advances simulated time after every instruction,
+/// calling back into `Interrupt::OneTick` once the clock reaches the next
+/// pending interrupt, and returns to the block engine as soon as an
+/// interrupt handler runs.  It is only entered outside of
+/// branch delay slots, so control can only leave at the end of the block,
+/// and when no delayed load is in progress, so it never has to deal with
+/// `DelayedLoad`.
+///
+/// Code is allocated sequentially from a fixed-size area.  Since a thread
+/// may be switched out in the middle of compiled code (by a time slice
+/// interrupt), nothing is ever released while some thread is inside it: the
+/// whole area is flushed at once, only when it is full and unused.
+///
+/// Only available on *HOST_x86_64*; elsewhere, `IsAvailable` is false and
+/// the block engine keeps interpreting.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_JITCOMPILER__HH
+#define NACHOS_MACHINE_JITCOMPILER__HH
+
+
+class Block;
+
+/// Entry point of compiled code.
+///
+/// Returns the index in the block of the next instruction to run, shifted
+/// left one bit; the lowest bit is set if an interrupt handler ran.
+typedef unsigned (*JitCode)();
+
+/// How many times a block has to run before it is compiled.
+const unsigned JIT_THRESHOLD = 32;
+
+/// Size of the area holding compiled code.
+const unsigned JIT_CODE_SIZE = 1 << 20;
+
+class JitCompiler {
+public:
+
+    /// Initialize a compiler generating code for the register file
+    /// `regs`.
+    ///
+    /// `eventHorizon` is kept by the caller at `Interrupt::NextEventTick`;
+    /// generated code reads it, and updates it whenever it calls
+    /// `Interrupt::OneTick`.
+    JitCompiler(int *regs, unsigned long *eventHorizon);
+
+    /// De-allocate the compiled code.
+    ~JitCompiler();
+
+    /// Return whether code can be generated on this host.
+    bool IsAvailable() const;
+
+    /// Return whether the instruction `opCode` can be compiled.
+    static bool CanCompile(unsigned char opCode);
+
+    /// Compile every run of compilable instructions in `block`, setting the
+    /// `native` entry point of each of their entries.
+    ///
+    /// Return false if there is no room left for the code.
+    bool Compile(Block *block);
+
+    /// Run compiled code, from entry point `code`.
+    unsigned Run(JitCode code);
+
+    /// Return whether the code area can be flushed right now, that is, no
+    /// thread is in the middle of compiled code.
+    bool CanFlush() const;
+
+    /// Forget all compiled code.  The caller must drop every entry point
+    /// previously handed out.
+    void Flush();
+
+private:
+    int *registers;
+    unsigned long *horizon;
+
+    char *code;    ///< Start of the code area.
+    unsigned used;  ///< Bytes of the code area already holding code.
+
+    unsigned active;  ///< Threads currently inside compiled code.
+};
+
+
+#endif
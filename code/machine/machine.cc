@@ -56,9 +56,30 @@ Machine::Machine(SingleStepper *st)
     }
 
     singleStepper = st;
+    blockEngine = nullptr;
     CheckEndian();
 }
 
+Machine::~Machine()
+{
+    delete blockEngine;
+}
+
+void
+Machine::EnableBlockEngine()
+{
+    if (blockEngine == nullptr) {
+        blockEngine = new BlockEngine(this);
+    }
+}
+
+bool
+Machine::EnableJit(bool lockstep)
+{
+    EnableBlockEngine();
+    return blockEngine->EnableJit(lockstep);
+}
+
 const int *
 Machine::GetRegisters() const
 {
@@ -21,6 +21,7 @@
 #define NACHOS_MACHINE_MACHINE__HH
 
 
+#include "block_engine.hh"
 #include "exception_type.hh"
 #include "mmu.hh"
 #include "single_stepper.hh"
@@ -70,11 +71,29 @@ public:
     /// Initialize the simulation of the hardware for running user programs.
     Machine(SingleStepper *st);
 
+    /// De-allocate the simulation data structures.
+    ~Machine();
+
     /// Routines callable by the Nachos kernel.
 
     /// Run a user program.
     void Run();
 
+    /// Run user programs with the basic-block engine instead of
+    /// interpreting one instruction at a time.
+    ///
+    /// The interpreter is still used while single stepping or tracing
+    /// machine emulation or address translation.
+    void EnableBlockEngine();
+
+    /// Also compile blocks that run often into host code; see
+    /// `jit_compiler.hh`.  If `lockstep` is set, check every stretch of
+    /// compiled code against the block handlers.
+    ///
+    /// Return false if the host does not support it, in which case the
+    /// block engine is still enabled.
+    bool EnableJit(bool lockstep);
+
     const int *GetRegisters() const;
 
     MMU *GetMMU();
@@ -97,13 +116,15 @@ public:
 
     /// Routines internal to the machine simulation -- DO NOT call these.
 
-    /// Fetch one instruction of a user program.
+    /// Fetch one instruction of a user program, already decoded.
     ///
     /// Return false if an exception occurs, true otherwise.
-    bool FetchInstruction(Instruction *instr);
+    bool FetchInstruction(const Instruction **instr);
 
     /// Run a certain instruction of a user program.
-    void ExecInstruction(const Instruction *instr);
+    ///
+    /// Return false if an exception occurs, true otherwise.
+    bool ExecInstruction(const Instruction *instr);
 
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
@@ -121,6 +142,8 @@ public:
     void SetHandler(ExceptionType et, ExceptionHandler handler);
 
 private:
+    friend class BlockEngine;
+
     SingleStepper *singleStepper;  ///< Drop back into the method of a
                                    ///< provided object (may be a debugger)
                                    ///< after each simulated instruction.
@@ -132,6 +155,8 @@ private:
     MMU mmu; ///< Memory management unit.
 
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
+
+    BlockEngine *blockEngine;  ///< Null unless enabled.
 };
 
 
@@ -27,19 +27,37 @@
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;
-      // Storage for decoded instruction.
+    const Instruction *instr;
+      // Decoded instruction, owned by the MMU's instruction cache.
 
     if (debug.IsEnabled('m')) {
         printf("Starting to run at time %lu\n", stats->totalTicks);
     }
     interrupt->SetStatus(USER_MODE);
 
+    // Traces are printed per instruction, so leave them to the interpreter.
+    bool useBlocks = blockEngine != nullptr
+                     && !debug.IsEnabled('m') && !debug.IsEnabled('a');
+
+    unsigned long horizon = interrupt->NextEventTick();
+
     for (;;) {
-        if (FetchInstruction(instr)) {
-            ExecInstruction(instr);
+        if (useBlocks && singleStepper == nullptr) {
+            blockEngine->RunBlock();
+            continue;
+        }
+        bool ok = FetchInstruction(&instr) && ExecInstruction(instr);
+
+        // Until the next pending interrupt, advancing time is all `OneTick`
+        // would do.  The horizon has to be looked up again whenever the
+        // kernel may have run: after an exception or an interrupt.
+        if (ok && singleStepper == nullptr
+              && stats->totalTicks + USER_TICK < horizon) {
+            interrupt->UserTick();
+        } else {
+            interrupt->OneTick();
+            horizon = interrupt->NextEventTick();
         }
-        interrupt->OneTick();
         if (singleStepper != nullptr && !singleStepper->Step()) {
             singleStepper = nullptr;
         }
@@ -60,16 +78,19 @@ Machine::DelayedLoad(unsigned nextReg, int nextValue)
 }
 
 bool
-Machine::FetchInstruction(Instruction *instr)
+Machine::FetchInstruction(const Instruction **decoded)
 {
-    ASSERT(instr != nullptr);
+    ASSERT(decoded != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    const Instruction *instr;
+    ExceptionType e = mmu.ReadInstruction(registers[PC_REG], &instr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
+    stats->numAccessMemory++;
+    stats->numHits++;
+    *decoded = instr;
 
     if (debug.IsEnabled('m')) {
         const struct OpString *str = &OP_STRINGS[instr->opCode];
@@ -171,7 +192,9 @@ Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 /// all data back to the machine registers and memory before leaving.  This
 /// allows the Nachos kernel to control our behavior by controlling the
 /// contents of memory, the translation table, and the register set.
-void
+///
+/// Returns false if the instruction trapped into the kernel.
+bool
 Machine::ExecInstruction(const Instruction *instr)
 {
     int nextLoadReg = 0;
@@ -192,7 +215,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT)
                   && (registers[instr->rs] ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = sum;
             break;
@@ -202,7 +225,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT)
                   && (instr->extra ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rt] = sum;
             break;
@@ -308,7 +331,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_LBU:
             tmp = registers[instr->rs] + instr->extra;
             if (!ReadMem(tmp, 1, &value)) {
-                return;
+                return false;
             }
 
             if (value & 0x80 && instr->opCode == OP_LB) {
@@ -325,10 +348,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x1) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
             if (!ReadMem(tmp, 2, &value)) {
-                return;
+                return false;
             }
 
             if (value & 0x8000 && instr->opCode == OP_LH) {
@@ -349,10 +372,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x3) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             nextLoadReg = instr->rt;
             nextLoadValue = value;
@@ -367,7 +390,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -400,7 +423,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -471,14 +494,14 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_SB:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           1, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
         case OP_SH:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           2, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
@@ -539,7 +562,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if ((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT
                   && (registers[instr->rs] ^ diff) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = diff;
             break;
@@ -552,7 +575,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_SW:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           4, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
@@ -564,7 +587,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -584,7 +607,7 @@ Machine::ExecInstruction(const Instruction *instr)
                     break;
             }
             if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+                return false;
             }
             break;
 
@@ -596,7 +619,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -615,13 +638,13 @@ Machine::ExecInstruction(const Instruction *instr)
                     break;
             }
             if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+                return false;
             }
             break;
 
         case OP_SYSCALL:
             RaiseException(SYSCALL_EXCEPTION, 0);
-            return;
+            return false;
 
         case OP_XOR:
             registers[instr->rd] = registers[instr->rs]
@@ -636,7 +659,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_RES:
         case OP_UNIMP:
             RaiseException(ILLEGAL_INSTR_EXCEPTION, 0);
-            return;
+            return false;
 
         default:
             ASSERT(false);
@@ -652,4 +675,5 @@ Machine::ExecInstruction(const Instruction *instr)
       // For debugging, in case we are jumping into lala-land.
     registers[PC_REG] = registers[NEXT_PC_REG];
     registers[NEXT_PC_REG] = pcAfter;
+    return true;
 }
@@ -18,7 +18,9 @@
 /// the hardware does not need to know anything at all about that.
 ///
 /// Note that the contents of the TLB are specific to an address space.
-/// If the address space changes, so does the contents of the TLB!
+/// Entries are tagged with an address space identifier, so those of several
+/// address spaces can be in the TLB at once; only the ones matching `asid`
+/// are used.
 ///
 /// DO NOT CHANGE -- part of the machine emulation
 ///
@@ -30,16 +32,28 @@
 
 #include "mmu.hh"
 #include "endianness.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 
+const char *TLB_POLICY_NAMES[NUM_TLB_POLICIES] = { "random", "lru", "plru" };
+
 MMU::MMU()
 {
     mainMemory = new char [MEMORY_SIZE];
     for (unsigned i = 0; i < MEMORY_SIZE; i++) {
         mainMemory[i] = 0;
     }
+    instrCache = new InstructionCache(NUM_PHYS_PAGES, PAGE_SIZE);
+
+    tlbSets    = TLB_SIZE / TLB_WAYS;
+    tlbClock   = 0;
+    lastTlbIndex = -1;
+    tlbLastUse = nullptr;
+    tlbTree    = nullptr;
+    asid       = 0;
 
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLB_SIZE];
@@ -47,29 +61,45 @@ MMU::MMU()
         tlb[i].valid = false;
     }
     pageTable = nullptr;
+    tlbLastUse = new unsigned long [TLB_SIZE];
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        tlbLastUse[i] = 0;
+    }
+    tlbTree = new unsigned [tlbSets];
+    for (unsigned i = 0; i < tlbSets; i++) {
+        tlbTree[i] = 0;
+    }
+    SetTlbPolicy(TLB_RANDOM);
 #else  // Use linear page table.
     tlb = nullptr;
     pageTable = nullptr;
 #endif
+    InvalidateTranslations();
+    traceTranslations = debug.IsEnabled('a');
 }
 
 MMU::~MMU()
 {
     delete [] mainMemory;
+    delete instrCache;
     if (tlb != nullptr) {
         delete [] tlb;
     }
+    delete [] tlbLastUse;
+    delete [] tlbTree;
 }
 
 void
 MMU::PrintTLB() const
 {
 #ifdef USE_TLB
-    printf("TLB content (%u entries):\n", TLB_SIZE);
+    printf("TLB content (%u entries, %u-way, %s):\n",
+           TLB_SIZE, TLB_WAYS, TLB_POLICY_NAMES[tlbPolicy]);
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d,"
+               " flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -165,10 +195,198 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
         default:
             ASSERT(false);
     }
+    instrCache->InvalidateWord(physicalAddress);
 
     return NO_EXCEPTION;
 }
 
+/// Read the instruction stored at virtual address `addr` and make `*instr`
+/// point to its decoded form.
+///
+/// Translation happens exactly as for a 4-byte `ReadMem`, so the TLB and the
+/// use bits behave the same; only the decoding step is skipped when the
+/// word is found in the cache.
+///
+/// * `addr` is the virtual address of the instruction.
+/// * `instr` is the place to store a pointer to the decoded instruction.
+///   The pointed object belongs to the cache and is only valid until the
+///   next memory write or frame invalidation.
+ExceptionType
+MMU::ReadInstruction(unsigned addr, const Instruction **instr)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned physicalAddress;
+    ExceptionType e = TranslateInstruction(addr, &physicalAddress);
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+    *instr = DecodeInstruction(physicalAddress);
+    return NO_EXCEPTION;
+}
+
+ExceptionType
+MMU::TranslateInstruction(unsigned addr, unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    DEBUG('a', "Reading VA 0x%X, size 4\n", addr);
+
+    return Translate(addr, physAddr, 4, false);
+}
+
+const Instruction *
+MMU::DecodeInstruction(unsigned physAddr)
+{
+    ASSERT(physAddr % 4 == 0 && physAddr < MEMORY_SIZE);
+
+    const Instruction *cached = instrCache->Lookup(physAddr);
+    if (cached == nullptr) {
+        unsigned raw = *(unsigned *) &mainMemory[physAddr];
+        cached = instrCache->Insert(physAddr, WordToHost(raw));
+    }
+    return cached;
+}
+
+unsigned
+MMU::GetFrameGeneration(unsigned frame) const
+{
+    return instrCache->GetGeneration(frame);
+}
+
+void
+MMU::InvalidateFrame(unsigned frame)
+{
+    instrCache->InvalidateFrame(frame);
+}
+
+void
+MMU::SetTlbPolicy(TlbPolicy policy)
+{
+    ASSERT(0 <= policy && policy < NUM_TLB_POLICIES);
+    // Tree pseudo-LRU needs a complete binary tree over each set.
+    ASSERT(policy != TLB_PLRU
+           || (TLB_WAYS <= BITS_IN_WORD && (TLB_WAYS & (TLB_WAYS - 1)) == 0));
+
+    tlbPolicy = policy;
+    stats->tlbPolicy = TLB_POLICY_NAMES[policy];
+}
+
+unsigned
+MMU::PickTlbVictim(unsigned vpn)
+{
+    ASSERT(tlb != nullptr);
+
+    unsigned first = vpn % tlbSets * TLB_WAYS;
+    unsigned victim;
+
+    stats->numTlbMisses++;
+    if (tlbPolicy == TLB_RANDOM) {
+        // Exactly as the kernel used to choose, for repeatable runs.
+        victim = first + rand() % TLB_WAYS;
+    } else {
+        victim = TLB_SIZE;
+        for (unsigned i = first; i < first + TLB_WAYS; i++) {
+            if (!tlb[i].valid) {
+                victim = i;
+                break;
+            }
+        }
+        if (victim == TLB_SIZE && tlbPolicy == TLB_LRU) {
+            victim = first;
+            for (unsigned i = first + 1; i < first + TLB_WAYS; i++) {
+                if (tlbLastUse[i] < tlbLastUse[victim]) {
+                    victim = i;
+                }
+            }
+        } else if (victim == TLB_SIZE) {  // Follow the tree bits.
+            unsigned node = 1;
+            while (node < TLB_WAYS) {
+                node = 2 * node + (tlbTree[first / TLB_WAYS] >> node & 1);
+            }
+            victim = first + node - TLB_WAYS;
+        }
+    }
+
+    if (tlb[victim].valid) {
+        stats->numTlbEvictions++;
+    }
+    DEBUG('a', "TLB entry %u chosen for virtual page %u\n", victim, vpn);
+    return victim;
+}
+
+/// Make every node of the tree on the way to entry `i` point away from it,
+/// or remember when it was used, depending on the policy.
+void
+MMU::TouchTlb(unsigned i)
+{
+    if (tlbPolicy == TLB_LRU) {
+        tlbLastUse[i] = ++tlbClock;
+    } else if (tlbPolicy == TLB_PLRU) {
+        unsigned *tree = &tlbTree[i / TLB_WAYS];
+        unsigned node  = TLB_WAYS + i % TLB_WAYS;
+        for (; node > 1; node /= 2) {
+            unsigned parent = node / 2;
+            if (node % 2 == 0) {
+                *tree |= 1U << parent;     // Came from the left.
+            } else {
+                *tree &= ~(1U << parent);  // Came from the right.
+            }
+        }
+    }
+}
+
+int
+MMU::GetLastTlbIndex() const
+{
+    return lastTlbIndex;
+}
+
+void
+MMU::TouchTlbFetch(int i)
+{
+    if (i >= 0) {
+        ASSERT((unsigned) i < TLB_SIZE);
+        TouchTlb(i);
+    }
+}
+
+void
+MMU::InvalidateTranslation(unsigned vpn)
+{
+    CachedTranslation *cached
+      = &translationCache[vpn % TRANSLATION_CACHE_SIZE];
+    if (cached->virtualPage == vpn) {
+        cached->entry = nullptr;
+    }
+}
+
+void
+MMU::InvalidateTranslations()
+{
+    for (unsigned i = 0; i < TRANSLATION_CACHE_SIZE; i++) {
+        translationCache[i].entry = nullptr;
+    }
+    cachedPageTable = pageTable;
+    cachedAsid      = asid;
+}
+
+TranslationEntry *
+MMU::LookupTlb(unsigned vpn, unsigned space) const
+{
+    ASSERT(tlb != nullptr);
+
+    // Only the set `vpn` maps to can hold it.
+    unsigned first = vpn % tlbSets * TLB_WAYS;
+    for (unsigned i = first; i < first + TLB_WAYS; i++) {
+        TranslationEntry *e = &tlb[i];
+        if (e->valid && e->virtualPage == vpn && e->asid == space) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
 ExceptionType
 MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 {
@@ -195,13 +413,10 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
     } else {
         // Use the TLB.
 
-        unsigned i;
-        for (i = 0; i < TLB_SIZE; i++) {
-            TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
-                *entry = e;  // FOUND!
-                return NO_EXCEPTION;
-            }
+        TranslationEntry *e = LookupTlb(vpn, asid);
+        if (e != nullptr) {
+            *entry = e;  // FOUND!
+            return NO_EXCEPTION;
         }
 
         // Not found.
@@ -224,11 +439,35 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 /// * `physAddr" is the place to store the physical address.
 /// * `size" is the amount of memory being read or written.
 /// * `writing` -- if true, check the “read-only” bit in the TLB.
+///
+/// Successful translations are remembered in `translationCache`, so that
+/// the next access to the same page only has to set the use and dirty bits
+/// again.  Misses, and therefore page faults, happen exactly as without it,
+/// as long as the kernel invalidates the translations it changes.
 ExceptionType
 MMU::Translate(unsigned virtAddr, unsigned *physAddr,
                unsigned size, bool writing)
 {
     ASSERT(physAddr != nullptr);
+
+    unsigned vpn = virtAddr / PAGE_SIZE;
+    CachedTranslation *cached
+      = &translationCache[vpn % TRANSLATION_CACHE_SIZE];
+    if (cached->entry != nullptr && cached->virtualPage == vpn
+          && (virtAddr & (size - 1)) == 0 && (cached->writable || !writing)
+          && pageTable == cachedPageTable && asid == cachedAsid) {
+        cached->entry->use = true;
+        if (writing) {
+            cached->entry->dirty = true;
+        }
+        if (cached->tlbIndex >= 0) {
+            TouchTlb(cached->tlbIndex);
+        }
+        lastTlbIndex = cached->tlbIndex;
+        *physAddr = cached->frameAddr + virtAddr % PAGE_SIZE;
+        return NO_EXCEPTION;
+    }
+
     // We must have either a TLB or a page table, but not both!
     ASSERT((tlb == nullptr) != (pageTable == nullptr));
 
@@ -243,7 +482,6 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     // Calculate the virtual page number, and offset within the page,
     // from the virtual address.
-    unsigned vpn    = (unsigned) virtAddr / PAGE_SIZE;
     unsigned offset = (unsigned) virtAddr % PAGE_SIZE;
 
     TranslationEntry *entry;
@@ -272,9 +510,25 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
     if (writing) {
         entry->dirty = true;
     }
+    int tlbIndex = tlb != nullptr ? entry - tlb : -1;
+    if (tlbIndex >= 0) {
+        TouchTlb(tlbIndex);
+    }
+    lastTlbIndex = tlbIndex;
 
     *physAddr = pageFrame * PAGE_SIZE + offset;
     ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
+
+    if (!traceTranslations) {
+        if (pageTable != cachedPageTable || asid != cachedAsid) {
+            InvalidateTranslations();
+        }
+        cached->virtualPage = vpn;
+        cached->entry       = entry;
+        cached->tlbIndex    = tlbIndex;
+        cached->frameAddr   = pageFrame * PAGE_SIZE;
+        cached->writable    = !entry->readOnly;
+    }
     return NO_EXCEPTION;
 }
@@ -11,23 +11,39 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "geometry.hh"
+#include "instruction_cache.hh"
 #include "translation_entry.hh"
 
 
 /// Definitions related to the size, and format of user memory.
+///
+/// The number of physical pages and of TLB entries can be chosen at
+/// startup; see `geometry.hh`.
 
 const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
                                          ///< disk sector size, for
                                          ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 4;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
-
-/// Number of entries in the TLB, if one is present.
-///
-/// If there is a TLB, it will be small compared to page tables.
-const unsigned TLB_SIZE = 4;
 
 const unsigned TRIES = 4;
+
+/// How to choose the TLB entry to replace on a miss, among those of the set
+/// the missing page maps to.
+enum TlbPolicy {
+    TLB_RANDOM,  ///< Any entry, at random, even if some other is invalid.
+    TLB_LRU,     ///< The least recently used entry.
+    TLB_PLRU,    ///< Tree pseudo-LRU; requires a power of two ways.
+    NUM_TLB_POLICIES
+};
+
+extern const char *TLB_POLICY_NAMES[NUM_TLB_POLICIES];
+
+/// Number of distinct address space identifiers the TLB can tell apart.
+const unsigned NUM_ASIDS = 64;
+
+/// Number of slots in the MMU's software translation cache.
+const unsigned TRANSLATION_CACHE_SIZE = 64;
+
 /// This class simulates an MMU (memory management unit) that can use either
 /// page tables or a TLB.
 class MMU {
@@ -45,8 +61,73 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Fetch the instruction at virtual address `addr`, already decoded.
+    ///
+    /// The decoded instruction is kept in a cache indexed by physical
+    /// address, so it is only decoded again if its word gets written or its
+    /// frame gets invalidated.
+    ExceptionType ReadInstruction(unsigned addr, const Instruction **instr);
+
+    /// Translate the address of an instruction fetch, with the same side
+    /// effects as `ReadInstruction`, but without decoding anything.
+    ExceptionType TranslateInstruction(unsigned addr, unsigned *physAddr);
+
+    /// Return the TLB entry the last successful translation went through,
+    /// or -1 if there is no TLB.
+    int GetLastTlbIndex() const;
+
+    /// Record another instruction fetch through TLB entry `i`, as repeating
+    /// the translation would, for code that fetches from a page it has
+    /// already translated.  `i` is -1 if there is no TLB.
+    void TouchTlbFetch(int i);
+
+    /// Return the decoded instruction stored at physical address
+    /// `physAddr`.
+    const Instruction *DecodeInstruction(unsigned physAddr);
+
+    /// Return the invalidation counter of physical frame `frame`; see
+    /// `InstructionCache::GetGeneration`.
+    unsigned GetFrameGeneration(unsigned frame) const;
+
+    /// Forget every decoded instruction belonging to physical frame
+    /// `frame`.
+    ///
+    /// The kernel must call this whenever the contents of a frame are
+    /// replaced behind the MMU's back (for example, when it is evicted and
+    /// given to another page).
+    void InvalidateFrame(unsigned frame);
+
+    /// Forget the cached translation of virtual page `vpn`, if any.
+    ///
+    /// The kernel must call this whenever it changes or invalidates the TLB
+    /// entry (or the page table entry, if there is no TLB) of `vpn`, in
+    /// whichever address space: the cache may have been filled while some
+    /// other one was running.
+    void InvalidateTranslation(unsigned vpn);
+
+    /// Forget every cached translation.
+    ///
+    /// The kernel must call this whenever it changes the TLB or the page
+    /// table as a whole.  Switching `pageTable` or `asid` needs no call.
+    void InvalidateTranslations();
+
     void PrintTLB() const;
 
+    /// Choose how TLB entries are replaced; `TLB_RANDOM` by default.
+    void SetTlbPolicy(TlbPolicy policy);
+
+    /// Return the index in `tlb` of the entry to load the translation of
+    /// virtual page `vpn` into, on a TLB miss: an invalid entry of the set
+    /// `vpn` maps to, or one chosen by the replacement policy.
+    ///
+    /// The caller is responsible for saving the use and dirty bits of the
+    /// entry, if it is valid.
+    unsigned PickTlbVictim(unsigned vpn);
+
+    /// Return the valid TLB entry mapping virtual page `vpn` of the address
+    /// space identified by `space`, or null if there is none.
+    TranslationEntry *LookupTlb(unsigned vpn, unsigned space) const;
+
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
     ///
@@ -82,8 +163,52 @@ public:
     TranslationEntry *pageTable;
     unsigned pageTableSize;
 
+    /// Identifier of the running address space.  Only TLB entries tagged
+    /// with it are used, so the TLB need not be flushed on a context switch.
+    unsigned asid;
+
 private:
 
+    /// Decoded copies of the instructions held in `mainMemory`.
+    InstructionCache *instrCache;
+
+    /// TLB replacement state.
+    TlbPolicy tlbPolicy;
+    unsigned tlbSets;
+    unsigned long tlbClock;      ///< Orders TLB accesses, for `TLB_LRU`.
+    unsigned long *tlbLastUse;   ///< Per entry, for `TLB_LRU`.
+    unsigned *tlbTree;           ///< Per set, for `TLB_PLRU`: bit `n` is
+                                 ///< node `n` of the tree, set if the
+                                 ///< victim is on the right.
+
+    /// Record an access to TLB entry `i`.
+    void TouchTlb(unsigned i);
+
+    /// See `GetLastTlbIndex`.
+    int lastTlbIndex;
+
+    /// A translation that `Translate` already went through successfully,
+    /// so that it can be repeated without looking it up again.
+    struct CachedTranslation {
+        unsigned virtualPage;
+        TranslationEntry *entry;  ///< Null if the slot is empty.
+        int tlbIndex;             ///< Index of `entry` in `tlb`, or -1.
+        unsigned frameAddr;       ///< Physical address of the frame.
+        bool writable;
+    };
+
+    /// Recent translations, indexed by virtual page number.
+    CachedTranslation translationCache[TRANSLATION_CACHE_SIZE];
+
+    /// Page table and address space in use when `translationCache` was
+    /// filled.
+    const TranslationEntry *cachedPageTable;
+    unsigned cachedAsid;
+
+    /// Whether translations are traced; if so, nothing gets cached, so
+    /// that every one of them is traced.
+    bool traceTranslations;
+
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
                                     TranslationEntry **entry) const;
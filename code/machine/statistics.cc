@@ -19,8 +19,24 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numDiskSectorsRead = numDiskSectorsWritten = 0;
+    numBufferCacheHits = numBufferCacheMisses = numBufferCacheWritebacks = 0;
+    numReadAheadSectors = numReadAheadHits = 0;
+    diskPolicy = nullptr;
+    diskQueueTicks = maxDiskQueueTicks = diskServiceTicks = 0;
+    diskSeekTracks = numDiskDeadlinesMissed = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageFaults = numZeroFills = numPacketsSent = numPacketsRecvd = 0;
+    numTlbMisses = numTlbEvictions = 0;
+    tlbPolicy = nullptr;
+    numPageEvictions = numPageouts = numSwaps = numRestoreSwaps = 0;
+    numPageCleans = 0;
+    numPageCacheHits = numPageCopies = 0;
+    numFaultAroundPages = numFaultAroundHits = numFaultAroundMisses = 0;
+    numSwapCacheStores = numSwapCacheRejects = numSwapCacheSpills = 0;
+    swapCacheBytesIn = swapCacheBytesOut = 0;
+    numSwapCacheHits = numSwapCacheMisses = 0;
+    pagePolicy = nullptr;
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -41,11 +57,63 @@ Statistics::Print()
     printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
            totalTicks, idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
+    if (numDiskSectorsRead + numDiskSectorsWritten
+          != numDiskReads + numDiskWrites) {
+        printf("Disk transfers: sectors read %lu, written %lu\n",
+               numDiskSectorsRead, numDiskSectorsWritten);
+    }
+    if (numBufferCacheHits + numBufferCacheMisses != 0) {
+        printf("Buffer cache: hits %lu, misses %lu, written back %lu\n",
+               numBufferCacheHits, numBufferCacheMisses,
+               numBufferCacheWritebacks);
+    }
+    if (numReadAheadSectors != 0) {
+        printf("Read-ahead: sectors %lu, used %lu\n",
+               numReadAheadSectors, numReadAheadHits);
+    }
+    if (diskPolicy != nullptr && numDiskReads + numDiskWrites != 0) {
+        unsigned long requests = numDiskReads + numDiskWrites;
+        printf("Disk queue (%s): average wait %lu, average service %lu,"
+               " longest wait %lu, tracks seeked %lu, past deadline %lu\n",
+               diskPolicy, diskQueueTicks / requests,
+               diskServiceTicks / requests, maxDiskQueueTicks,
+               diskSeekTracks, numDiskDeadlinesMissed);
+    }
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
-    printf("Paging: faults %lu\n", numPageFaults);
+    printf("Paging: faults %lu (%lu zero-filled)\n",
+           numPageFaults, numZeroFills);
+    if (numFaultAroundPages != 0) {
+        printf("Fault-around: pages %lu, used %lu, evicted unused %lu\n",
+               numFaultAroundPages, numFaultAroundHits, numFaultAroundMisses);
+    }
+    if (numPageCacheHits != 0) {
+        printf("Page cache: shared code pages %lu\n", numPageCacheHits);
+    }
+    if (numPageCopies != 0) {
+        printf("Copy-on-write: pages copied %lu\n", numPageCopies);
+    }
+    if (pagePolicy != nullptr) {
+        printf("Page replacement (%s): evictions %lu (%lu in background),"
+               " cleaned in background %lu, swapped out %lu, swapped in %lu\n",
+               pagePolicy, numPageEvictions, numPageouts, numPageCleans,
+               numSwaps, numRestoreSwaps);
+    }
+    if (numSwapCacheStores + numSwapCacheRejects != 0) {
+        printf("Swap cache: stored %lu (ratio %.2f), not compressible %lu,"
+               " spilled %lu, hits %lu, misses %lu\n",
+               numSwapCacheStores,
+               swapCacheBytesOut != 0
+                 ? (double) swapCacheBytesIn / swapCacheBytesOut : 0.0,
+               numSwapCacheRejects, numSwapCacheSpills,
+               numSwapCacheHits, numSwapCacheMisses);
+    }
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
     printf("Hit ratio: access memory %lu, hits %lu, failures %lu\n",
            numAccessMemory, numHits, numFailures);
+    if (tlbPolicy != nullptr) {
+        printf("TLB (%s): misses %lu, evictions %lu\n",
+               tlbPolicy, numTlbMisses, numTlbEvictions);
+    }
 }
@@ -38,6 +38,35 @@ public:
     /// Number of disk write requests.
     unsigned long numDiskWrites;
 
+    /// Number of sectors read and written by those requests.
+    unsigned long numDiskSectorsRead;
+    unsigned long numDiskSectorsWritten;
+
+    /// Number of sectors found in the buffer cache or not, and of dirty
+    /// buffers written back to disk.
+    unsigned long numBufferCacheHits;
+    unsigned long numBufferCacheMisses;
+    unsigned long numBufferCacheWritebacks;
+
+    /// Number of sectors read ahead into the buffer cache, and how many of
+    /// them got used.
+    unsigned long numReadAheadSectors;
+    unsigned long numReadAheadHits;
+
+    /// Order in which disk requests are served; null if there is no disk.
+    const char *diskPolicy;
+
+    /// Ticks disk requests spent queued, the longest any of them did, and
+    /// ticks spent being served.
+    unsigned long diskQueueTicks;
+    unsigned long maxDiskQueueTicks;
+    unsigned long diskServiceTicks;
+
+    /// Number of tracks the disk head moved over, and of requests served
+    /// out of order because they had waited for too long.
+    unsigned long diskSeekTracks;
+    unsigned long numDiskDeadlinesMissed;
+
     /// Number of characters read from the keyboard.
     unsigned long numConsoleCharsRead;
 
@@ -47,6 +76,10 @@ public:
     /// Number of virtual memory page faults.
     unsigned long numPageFaults;
 
+    /// Number of pages filled with zeros instead of being read from
+    /// anywhere.
+    unsigned long numZeroFills;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
@@ -63,6 +96,54 @@ public:
 
     unsigned long numRestoreSwaps;
 
+    /// Number of frames taken away from a page to give them to another.
+    unsigned long numPageEvictions;
+
+    /// Number of those evictions done by the page-out daemon.
+    unsigned long numPageouts;
+
+    /// Number of dirty pages the page-out daemon wrote back, leaving them
+    /// in memory, clean, to be evicted later without waiting.
+    unsigned long numPageCleans;
+
+    /// Number of pages brought in along with a faulting one, and how many
+    /// of them got used, or evicted before that.
+    unsigned long numFaultAroundPages;
+    unsigned long numFaultAroundHits;
+    unsigned long numFaultAroundMisses;
+
+    /// Number of page faults on code pages already loaded by some other
+    /// process.
+    unsigned long numPageCacheHits;
+
+    /// Number of pages shared after `Fork` that had to be copied when
+    /// written.
+    unsigned long numPageCopies;
+
+    /// Number of pages kept compressed in the swap cache, turned away
+    /// because they did not compress, and written to disk when it
+    /// overflowed; their bytes before and after compression; and how many
+    /// reads from swap were served from the cache or not.
+    unsigned long numSwapCacheStores;
+    unsigned long numSwapCacheRejects;
+    unsigned long numSwapCacheSpills;
+    unsigned long swapCacheBytesIn;
+    unsigned long swapCacheBytesOut;
+    unsigned long numSwapCacheHits;
+    unsigned long numSwapCacheMisses;
+
+    /// Page replacement policy the paging counters refer to; null if
+    /// there is no coremap.
+    const char *pagePolicy;
+
+    /// Number of TLB refills, and how many of them replaced a valid entry.
+    unsigned long numTlbMisses;
+    unsigned long numTlbEvictions;
+
+    /// Replacement policy the TLB counters refer to; null if there is no
+    /// TLB.
+    const char *tlbPolicy;
+
 #ifdef DFS_TICKS_FIX
     /// Number of times the tick count gets reset.
     unsigned long tickResets;
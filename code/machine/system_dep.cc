@@ -51,6 +51,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 }
 
@@ -199,6 +200,22 @@ Unlink(const char *name)
     return unlink(name);
 }
 
+/// Tell which file `fd` is, and which version of it.
+///
+/// Abort on error.
+void
+Identify(int fd, unsigned long *inode, unsigned long *modified)
+{
+    ASSERT(inode != nullptr);
+    ASSERT(modified != nullptr);
+
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    *inode = st.st_ino;
+    *modified = st.st_mtim.tv_sec * 1000000000UL + st.st_mtim.tv_nsec;
+}
+
 /// Open an interprocess communication (IPC) connection.
 ///
 /// For now, just open a datagram port where other Nachos (simulating
@@ -395,4 +412,31 @@ DeallocBoundedArray(const char *ptr, unsigned size)
     delete [] (ptr - pgSize);
 }
 
+/// Return a region of memory that is readable, writable and executable, or
+/// null if it cannot be obtained.
+///
+/// * `size` -- amount of space needed (in bytes).
+char *
+AllocExecutable(unsigned size)
+{
+    ASSERT(size > 0);
+
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : (char *) ptr;
+}
+
+/// Give back a region obtained from `AllocExecutable`.
+///
+/// * `ptr` is the region to be deallocated.
+/// * `size` is its size (in bytes).
+void
+DeallocExecutable(char *ptr, unsigned size)
+{
+    ASSERT(ptr != nullptr);
+    ASSERT(size > 0);
+
+    munmap(ptr, size);
+}
+
 };
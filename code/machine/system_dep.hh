@@ -45,6 +45,10 @@ namespace SystemDep {
 
     bool Unlink(const char *name);
 
+    /// Set `inode` to the inode number of the open file `fd`, and
+    /// `modified` to the time it was last modified, in nanoseconds.
+    void Identify(int fd, unsigned long *inode, unsigned long *modified);
+
     /// Interprocess communication operations, for simulating the network.
 
     int OpenSocket();
@@ -81,6 +85,13 @@ namespace SystemDep {
     char *AllocBoundedArray(unsigned size);
 
     void DeallocBoundedArray(const char *p, unsigned size);
+
+    /// Allocate, de-allocate memory that can hold host code generated at
+    /// run time.  Return null if the host does not allow it.
+
+    char *AllocExecutable(unsigned size);
+
+    void DeallocExecutable(char *p, unsigned size);
 };
 
 
@@ -54,6 +54,10 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// Only meaningful in the TLB: the address space identifier the entry
+    /// belongs to.  The entry is ignored unless it matches `MMU::asid`.
+    unsigned asid;
+
 };
 
 
@@ -12,8 +12,18 @@
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
 ///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
+///            [-s] [-bb] [-jit] [-jitc] [-pages <# of frames>]
+///            [-tlb <# of entries>] [-tlbways <# of ways>]
+///            [-tlbpolicy <random|lru|plru>]
+///            [-prpolicy <random|fifo|clock|aging|wsclock|opt>]
+///            [-prtrace <file>] [-swap <# of slots>]
+///            [-swapcache <# of pages>]
+///            [-pageout <low water> <high water>] [-x <nachos file>]
+///            [-tc <consoleIn> <consoleOut>]
+///            [-f] [-tracks <# of tracks>] [-spt <sectors per track>]
+///            [-cache <# of sectors>]
+///            [-diskpolicy <fifo|scan|clook|deadline>]
+///            [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
 ///            [-tn <other machine id>]
@@ -39,6 +49,32 @@
 /// ----------------------
 ///
 /// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-bb` -- executes user programs one basic block at a time.
+/// * `-jit` -- like `-bb`, but also compiles frequently run blocks into host
+///            code (x86-64 hosts only).
+/// * `-jitc` -- like `-jit`, but checks the compiled code against the basic
+///            block engine, comparing register files after every run.
+/// * `-pages` -- sets the number of physical page frames (default 4).
+/// * `-tlb` -- sets the number of TLB entries (default 4).
+/// * `-tlbways` -- sets the associativity of the TLB (default: fully
+///            associative; at least 2 ways).
+/// * `-tlbpolicy` -- sets the TLB replacement policy: `random` (default),
+///            `lru` or `plru` (pseudo-LRU).
+/// * `-prpolicy` -- sets the page replacement policy: `random`, `fifo`,
+///            `clock` (enhanced second chance), `aging`, `wsclock` or `opt`
+///            (Belady's, replaying a trace given with `-prtrace`).  The
+///            default depends on the build (`clock` for *VMEM*).
+/// * `-prtrace` -- with `-prpolicy opt`, reads the page reference string
+///            from the given file; otherwise records it there.
+/// * `-swap` -- sets the number of pages the swap area can hold (*VMEM*
+///            only; default 1024).
+/// * `-swapcache` -- sets how many pages' worth of compressed data the swap
+///            cache keeps in memory before writing to the swap area (*VMEM*
+///            only; default half the frames; 0 turns it off).
+/// * `-pageout` -- sets how many frames the page-out daemon keeps free: it
+///            is woken up below the first number and evicts pages until the
+///            second is reached (*VMEM* only; default an eighth and a
+///            quarter of the frames; 0 0 turns it off).
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
 ///
@@ -46,6 +82,15 @@
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
+/// * `-tracks` -- sets the number of disk tracks (default 32).
+/// * `-spt` -- sets the number of sectors per disk track (default 32).  The
+///            disk has to be formatted again after changing its geometry.
+/// * `-cache` -- sets the number of sectors kept in memory by the buffer
+///            cache (default 64; 0 turns it off).
+/// * `-diskpolicy` -- sets the order in which queued disk requests are
+///            served: `fifo`, `scan` (elevator), `clook` (circular, upwards
+///            only) or `deadline` (default; `clook`, unless a request has
+///            waited for too long).
 /// * `-cp` -- copies a file from UNIX to Nachos.
 /// * `-pr` -- prints a Nachos file to standard output.
 /// * `-rm` -- removes a Nachos file from the file system.
@@ -194,6 +239,9 @@ main(int argc, char **argv)
 #endif // NETWORK
     }
 
+#ifdef FILESYS
+    synchDisk->Flush();  // Nachos may never halt, with the console on.
+#endif
     currentThread->Finish();
       // NOTE: if the procedure `main` returns, then the program `nachos`
       // will exit (as any other normal program would).  But there may be
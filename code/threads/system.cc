@@ -18,6 +18,7 @@
 #include "lib/coremap.hh"
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -51,10 +52,18 @@ Machine *machine;  ///< User program memory and registers.
 SynchConsole *synchConsole;
 Coremap *usedPages;
 Lock *lockCoremap;
-Lock *lockTLB;
 Lock *lockRAM;
 #endif
 
+#ifdef VMEM
+PageCache *pageCache;
+#endif
+
+#ifdef SWAP
+SwapArea *swapArea;
+PageoutDaemon *pageoutDaemon;
+#endif
+
 #ifdef NETWORK
 PostOffice *postOffice;
 #endif
@@ -117,6 +126,55 @@ ParseDebugOpts(char *s, DebugOpts *out)
     return true;
 }
 
+#ifdef USER_PROGRAM
+static bool
+ParseTlbPolicy(const char *s, TlbPolicy *out)
+{
+    ASSERT(s != nullptr);
+    ASSERT(out != nullptr);
+
+    for (unsigned i = 0; i < NUM_TLB_POLICIES; i++) {
+        if (strcmp(s, TLB_POLICY_NAMES[i]) == 0) {
+            *out = (TlbPolicy) i;
+            return true;
+        }
+    }
+    return false;  // Invalid policy.
+}
+
+static bool
+ParsePagePolicy(const char *s, PagePolicy *out)
+{
+    ASSERT(s != nullptr);
+    ASSERT(out != nullptr);
+
+    for (unsigned i = 0; i < NUM_PAGE_POLICIES; i++) {
+        if (strcmp(s, PAGE_POLICY_NAMES[i]) == 0) {
+            *out = (PagePolicy) i;
+            return true;
+        }
+    }
+    return false;  // Invalid policy.
+}
+#endif
+
+#ifdef FILESYS
+static bool
+ParseDiskPolicy(const char *s, DiskPolicy *out)
+{
+    ASSERT(s != nullptr);
+    ASSERT(out != nullptr);
+
+    for (unsigned i = 0; i < NUM_DISK_POLICIES; i++) {
+        if (strcmp(s, DISK_POLICY_NAMES[i]) == 0) {
+            *out = (DiskPolicy) i;
+            return true;
+        }
+    }
+    return false;  // Invalid policy.
+}
+#endif
+
 /// Initialize Nachos global data structures.
 ///
 /// Interpret command line arguments in order to determine flags for the
@@ -145,10 +203,31 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    bool blockEngine = false;    // Run user programs by basic blocks.
+    bool jit = false;            // Compile hot blocks into host code.
+    bool jitLockstep = false;    // Check compiled code against the blocks.
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+    unsigned tlbSize = DEFAULT_TLB_SIZE;
+    unsigned tlbWays = 0;  // Fully associative.
+    TlbPolicy tlbPolicy = TLB_RANDOM;
+    PagePolicy pagePolicy = DEFAULT_PAGE_POLICY;
+    const char *pageTrace = nullptr;  // Reference string to record or replay.
+#endif
+#ifdef SWAP
+    unsigned numSwapSlots = DEFAULT_NUM_SWAP_SLOTS;
+    int pageoutLow = -1;  // Watermarks of free frames; -1 for the default.
+    int pageoutHigh = -1;
+    int swapCachePages = -1;  // -1 for the default.
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
 #endif
+#ifdef FILESYS
+    unsigned numTracks = DEFAULT_NUM_TRACKS;
+    unsigned sectorsPerTrack = DEFAULT_SECTORS_PER_TRACK;
+    unsigned numBuffers = DEFAULT_NUM_BUFFERS;
+    DiskPolicy diskPolicy = DEFAULT_DISK_POLICY;
+#endif
 #ifdef NETWORK
     double rely = 1;  // Network reliability.
     int netname = 0;  // UNIX socket name.
@@ -188,6 +267,53 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-bb")) {
+            blockEngine = true;
+        } else if (!strcmp(*argv, "-jit")) {
+            jit = true;
+        } else if (!strcmp(*argv, "-jitc")) {
+            jit = true;
+            jitLockstep = true;
+        } else if (!strcmp(*argv, "-pages")) {
+            ASSERT(argc > 1);
+            numPhysPages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbways")) {
+            ASSERT(argc > 1);
+            tlbWays = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbpolicy")) {
+            ASSERT(argc > 1);
+            ASSERT(ParseTlbPolicy(*(argv + 1), &tlbPolicy));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-prpolicy")) {
+            ASSERT(argc > 1);
+            ASSERT(ParsePagePolicy(*(argv + 1), &pagePolicy));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-prtrace")) {
+            ASSERT(argc > 1);
+            pageTrace = *(argv + 1);
+            argCount = 2;
+        }
+#endif
+#ifdef SWAP
+        if (!strcmp(*argv, "-swap")) {
+            ASSERT(argc > 1);
+            numSwapSlots = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-swapcache")) {
+            ASSERT(argc > 1);
+            swapCachePages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-pageout")) {
+            ASSERT(argc > 2);
+            pageoutLow = atoi(*(argv + 1));
+            pageoutHigh = atoi(*(argv + 2));
+            argCount = 3;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -195,6 +321,25 @@ Initialize(int argc, char **argv)
             format = true;
         }
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-tracks")) {
+            ASSERT(argc > 1);
+            numTracks = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-spt")) {
+            ASSERT(argc > 1);
+            sectorsPerTrack = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-cache")) {
+            ASSERT(argc > 1);
+            numBuffers = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-diskpolicy")) {
+            ASSERT(argc > 1);
+            ASSERT(ParseDiskPolicy(*(argv + 1), &diskPolicy));
+            argCount = 2;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-n")) {
             ASSERT(argc > 1);
@@ -208,6 +353,15 @@ Initialize(int argc, char **argv)
 #endif
     }
 
+#ifdef USER_PROGRAM
+    if (!IsValidTlbGeometry(tlbSize, tlbWays)) {
+        fprintf(stderr, "Usage: -tlb <# of entries> -tlbways <# of ways>:"
+                        " entries must split evenly into sets of at least"
+                        " 2 ways.\n");
+        exit(1);
+    }
+#endif
+
     debug.SetFlags(debugFlags);  // Initialize `DEBUG` messages.
     debug.SetOpts(debugOpts);    // Set debugging behavior.
     stats = new Statistics;      // Collect statistics.
@@ -235,24 +389,53 @@ Initialize(int argc, char **argv)
     }
 
 #ifdef USER_PROGRAM
+    SetMemoryGeometry(numPhysPages, tlbSize, tlbWays);
     Debugger *d = debugUserProg ? new Debugger : nullptr;
     machine = new Machine(d);  // This must come first.
+#ifdef USE_TLB
+    machine->GetMMU()->SetTlbPolicy(tlbPolicy);
+#endif
+    if (blockEngine) {
+        machine->EnableBlockEngine();
+    }
+    if (jit && !machine->EnableJit(jitLockstep)) {
+        fprintf(stderr, "JIT not available on this host,"
+                        " running basic blocks only.\n");
+    }
     usedPages = new Coremap(NUM_PHYS_PAGES);
+    ASSERT(pagePolicy != PAGE_OPTIMAL || pageTrace != nullptr);
+    usedPages->SetPolicy(pagePolicy, pageTrace);
     lockCoremap = new Lock("Bit map pages lock");
-    lockTLB = new Lock("TLB Lock");
+#ifdef VMEM
+    pageCache = new PageCache(NUM_PHYS_PAGES);
+#endif
     lockRAM = new Lock("main memory lock");
     synchConsole = new SynchConsole("Console");
     SetExceptionHandlers();
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    SetDiskGeometry(numTracks, sectorsPerTrack);
+    synchDisk = new SynchDisk("DISK", numBuffers, diskPolicy);
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef SWAP
+    if (swapCachePages < 0) {
+        swapCachePages = NUM_PHYS_PAGES / SWAP_CACHE_DIVISOR;
+    }
+    swapArea = new SwapArea("SWAP", numSwapSlots,
+                            swapCachePages * PAGE_SIZE);
+    if (pageoutLow < 0) {
+        pageoutLow = NUM_PHYS_PAGES / PAGEOUT_LOW_WATER_DIVISOR;
+        pageoutHigh = NUM_PHYS_PAGES / PAGEOUT_HIGH_WATER_DIVISOR;
+    }
+    pageoutDaemon = new PageoutDaemon(pageoutLow, pageoutHigh);
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
@@ -264,6 +447,12 @@ Cleanup()
 {
     DEBUG('i', "Cleaning up...\n");
 
+#ifdef FILESYS
+    // Already done by `Interrupt::Halt`, but not on ctl-C.  It may block,
+    // so do it before anything it could switch to is gone.
+    synchDisk->Flush();
+#endif
+
     // 2007, Jose Miguel Santos Espino
     delete preemptiveScheduler;
 
@@ -276,10 +465,17 @@ Cleanup()
     delete usedPages;
     delete synchConsole;
     delete lockCoremap;
-    delete lockTLB;
+#ifdef VMEM
+    delete pageCache;
+#endif
     delete lockRAM;
 #endif
 
+#ifdef SWAP
+    delete pageoutDaemon;
+    delete swapArea;
+#endif
+
 #ifdef FILESYS_NEEDED
     delete fileSystem;
 #endif
@@ -42,10 +42,21 @@ extern Machine *machine;  // User program memory and registers.
 extern SynchConsole *synchConsole;
 extern Coremap *usedPages;
 extern Lock *lockCoremap;
-extern Lock *lockTLB;
 extern Lock *lockRAM;
 #endif
 
+#ifdef VMEM
+#include "vmem/page_cache.hh"
+extern PageCache *pageCache;
+#endif
+
+#ifdef SWAP
+#include "vmem/swap_area.hh"
+#include "vmem/pageout_daemon.hh"
+extern SwapArea *swapArea;
+extern PageoutDaemon *pageoutDaemon;
+#endif
+
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
 #include "filesys/file_system.hh"
 extern FileSystem *fileSystem;
@@ -133,6 +133,22 @@ Close:
         j       $31
         .end    Close
 
+        .globl  Mmap
+        .ent    Mmap
+Mmap:
+        addiu   $2, $0, SC_MMAP
+        syscall
+        j       $31
+        .end    Mmap
+
+        .globl  Munmap
+        .ent    Munmap
+Munmap:
+        addiu   $2, $0, SC_MUNMAP
+        syscall
+        j       $31
+        .end    Munmap
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
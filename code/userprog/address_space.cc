@@ -15,6 +15,9 @@
 #include <stdio.h>
 
 
+AddressSpace *AddressSpace::asidOwners[NUM_ASIDS];
+unsigned AddressSpace::nextAsidVictim = 0;
+
 /// First, set up the translation from program memory to physical memory.
 /// For now, this is really simple (1:1), since we are only uniprogramming,
 /// and we have a single unsegmented page table.
@@ -31,6 +34,13 @@ AddressSpace::AddressSpace(OpenFile *executable_file, Thread *hilo, char **args)
 
     // First, set up the translation.
     pageTable = new TranslationEntry[numPages];
+    pages = new PageDescriptor[numPages];
+    programPages = numPages;
+#ifdef SWAP
+    swapReserved = swapArea->Reserve(programPages);
+#endif
+    lastFault = -1;
+    faultWindow = FAULT_AROUND_INITIAL_WINDOW;
 
     #ifndef DEMAND_LOADING
         lockCoremap->Acquire();
@@ -40,26 +50,21 @@ AddressSpace::AddressSpace(OpenFile *executable_file, Thread *hilo, char **args)
     #endif
     for (unsigned i = 0; i < numPages; i++) {
         #ifndef DEMAND_LOADING
-            pageTable[i].physicalPage = usedPages->Find(i, currentThread);
+            pageTable[i].physicalPage = usedPages->Find(i, hilo);
         #endif
         #ifdef DEMAND_LOADING
-            pageTable[i].physicalPage = NOT_ALLOCATE_VALUE;
+            pageTable[i].physicalPage = NOT_RESIDENT;
         #endif
         pageTable[i].virtualPage  = i;
           // For now, virtual page number = physical page number.
         pageTable[i].valid        = true;
         pageTable[i].use          = false;
         pageTable[i].dirty        = false;
-        pageTable[i].readOnly     = false;
-          // If the code segment was entirely on a separate page, we could
-          // set its pages to be read-only.
+        pageTable[i].readOnly     = IsSharedText(i);
+          // Pages with nothing but code are read-only, so that they can be
+          // shared.
+        ClearDescriptor(&pages[i], InitialBacking(i));
     }
-    #ifdef SWAP
-        char filename[100];
-        sprintf(filename, "SWAP.%u", hilo);
-        fileSystem->Create(filename, PAGE_SIZE * numPages);
-        swap = fileSystem->Open(filename);
-    #endif
     #ifndef DEMAND_LOADING
         lockCoremap->Release();
         char *mainMemory = machine->GetMMU()->mainMemory;
@@ -126,25 +131,108 @@ AddressSpace::AddressSpace(OpenFile *executable_file, Thread *hilo, char **args)
     #endif
     thread = hilo;
     initsArgs = args;
+    asid = -1;
+}
+
+/// Create a copy of address space `parent` for thread `child`, which it
+/// becomes the address space of, as `Fork` does.
+///
+/// Nothing is copied yet.  Resident pages are mapped by both address
+/// spaces, and swapped out ones share their swap slot; either way, they
+/// are made read-only on both sides, and a page only gets copied when one
+/// of them writes to it (see `CopyOnWrite`).  Code pages are simply shared.
+/// Mapped files are left out.
+AddressSpace::AddressSpace(AddressSpace *parent, Thread *child)
+{
+    ASSERT(parent != nullptr);
+    ASSERT(child != nullptr);
+
+    // Pages not loaded yet are read from the executable, just like in the
+    // parent, even if its file has been removed since.
+    exe = parent->exe;
+    exe->Share();
+
+    numPages = programPages = parent->programPages;
+#ifdef SWAP
+    swapReserved = swapArea->Reserve(programPages);
+#endif
+    pageTable = new TranslationEntry[numPages];
+    pages = new PageDescriptor[numPages];
+    lastFault = -1;
+    faultWindow = FAULT_AROUND_INITIAL_WINDOW;
+    thread = child;
+    initsArgs = nullptr;
+    asid = -1;
+    child->space = this;
+
+    lockCoremap->Acquire();
+    for (unsigned i = 0; i < numPages; i++) {
+        // Bring the use and dirty bits of the parent up to date, and make it
+        // fault on its next write.
+        parent->EvictPage(i);
+        pageTable[i] = parent->pageTable[i];
+        ClearDescriptor(&pages[i], parent->pages[i].backing);
+        if (!IsSharedText(i)) {
+            pages[i].copyOnWrite = parent->pages[i].copyOnWrite = true;
+            pageTable[i].readOnly = parent->pageTable[i].readOnly = true;
+        }
+        #ifdef SWAP
+            pages[i].swapSlot = parent->pages[i].swapSlot;
+            if (pages[i].swapSlot != NO_SWAP_SLOT) {
+                swapArea->Share(pages[i].swapSlot);
+            }
+        #endif
+        if (pageTable[i].physicalPage >= 0) {
+            usedPages->Share(pageTable[i].physicalPage, child);
+        }
+    }
+    lockCoremap->Release();
 }
 
-/// Deallocate an address space.
+/// Deallocate an address space, giving back its frames (or its share of
+/// them), its swap slots and its TLB entries.  Mapped files get their dirty
+/// pages written back.
 ///
-/// Nothing for now!
+/// The TLB entries go last: the thread may be switched out before that,
+/// and `RestoreState` would then give the space an identifier again.
+/// Pages being written back by the page-out daemon are waited for.
 AddressSpace::~AddressSpace()
 {
+    lockCoremap->Acquire();
     for (unsigned i = 0; i < numPages; i++) {
-        usedPages->Clear(pageTable[i].physicalPage);
+        MappedFile *m = pages[i].file;
+        int frame = SettledFrame(i);
+        if (frame >= 0) {
+            if (m != nullptr) {
+                EvictPage(i);
+                if (pageTable[i].dirty) {
+                    WriteBack(m, i, frame);
+                }
+            }
+            usedPages->Unmap(frame, thread);
+        }
+        if (m != nullptr && m->firstPage == i) {
+            delete m;
+        }
+        #ifdef SWAP
+            if (pages[i].swapSlot != NO_SWAP_SLOT) {
+                swapArea->Free(pages[i].swapSlot);
+            }
+        #endif
+    }
+    lockCoremap->Release();
+#ifdef SWAP
+    if (swapReserved) {
+        swapArea->Unreserve(programPages);
+    }
+#endif
+    ReleaseAsid();
+    if (exe->Release()) {
+        delete exe;
     }
-    #ifdef SWAP
-        delete swap;
-        char filename[100];
-        sprintf(filename, "SWAP.%u", this);
-        fileSystem->Remove(filename);
-    #endif
-    delete exe;
     delete initsArgs;
     delete [] pageTable;
+    delete [] pages;
 }
 
 /// Set the initial values for the user-level register set.
@@ -178,36 +266,387 @@ AddressSpace::InitRegisters()
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
-/// For now, nothing!
+/// Nothing: TLB entries are tagged with `asid`, so they stay in the TLB
+/// while other address spaces run, and their use and dirty bits are only
+/// written back when they are evicted.
 void
 AddressSpace::SaveState()
-{
-    TranslationEntry *tlb = machine->GetMMU()->tlb;
-    unsigned int vpn;
-    for(unsigned int i = 0; i < TLB_SIZE; i++){
-        vpn = tlb[i].virtualPage;
-        if(tlb[i].valid) {
-            pageTable[vpn].dirty = tlb[i].dirty;
-            pageTable[vpn].use = tlb[i].use;
-            pageTable[vpn].physicalPage = tlb[i].physicalPage;
-            pageTable[vpn].valid = tlb[i].valid;
-            pageTable[vpn].readOnly = tlb[i].readOnly;
-        }
-    }
-}
+{}
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
 ///
-/// For now, tell the machine where to find the page table.
+/// For now, tell the machine which TLB entries are ours.
 void
 AddressSpace::RestoreState()
 {
     // machine->GetMMU()->pageTable     = pageTable;
     // machine->GetMMU()->pageTableSize = numPages;
-    TranslationEntry *tlb = machine->GetMMU()->tlb;
-    for(unsigned int i = 0; i < TLB_SIZE; i++)
-        tlb[i].valid = false;
+    if (asid < 0) {
+        AcquireAsid();
+    }
+    machine->GetMMU()->asid = asid;
+}
+
+void
+AddressSpace::AcquireAsid()
+{
+    for (unsigned i = 0; i < NUM_ASIDS; i++) {
+        if (asidOwners[i] == nullptr) {
+            asid = i;
+            asidOwners[i] = this;
+            return;
+        }
+    }
+
+    // All taken: recycle them in turn.
+    unsigned victim = nextAsidVictim;
+    nextAsidVictim = (nextAsidVictim + 1) % NUM_ASIDS;
+    DEBUG('z', "Taking address space identifier %u away\n", victim);
+    asidOwners[victim]->ReleaseAsid();
+    asid = victim;
+    asidOwners[victim] = this;
+}
+
+void
+AddressSpace::ReleaseAsid()
+{
+    if (asid < 0) {
+        return;
+    }
+    MMU *mmu = machine->GetMMU();
+    if (mmu->tlb != nullptr) {
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            TranslationEntry *e = &mmu->tlb[i];
+            if (e->valid && e->asid == (unsigned) asid) {
+                SaveTlbEntry(e);
+                e->valid = false;
+            }
+        }
+    }
+    mmu->InvalidateTranslations();
+    asidOwners[asid] = nullptr;
+    asid = -1;
+}
+
+TranslationEntry *
+AddressSpace::GetTlbEntry(unsigned int vpn)
+{
+    MMU *mmu = machine->GetMMU();
+    if (asid < 0 || mmu->tlb == nullptr) {
+        return nullptr;
+    }
+    return mmu->LookupTlb(vpn, asid);
+}
+
+void
+AddressSpace::SaveTlbEntry(const TranslationEntry *e)
+{
+    ASSERT(e->asid < NUM_ASIDS && asidOwners[e->asid] != nullptr);
+
+    TranslationEntry *row = &asidOwners[e->asid]->pageTable[e->virtualPage];
+    row->use   = e->use;
+    row->dirty = e->dirty;
+}
+
+void
+AddressSpace::EvictPage(unsigned int vpn)
+{
+    TranslationEntry *e = GetTlbEntry(vpn);
+    if (e != nullptr) {
+        SaveTlbEntry(e);
+        e->valid = false;
+        machine->GetMMU()->InvalidateTranslation(vpn);
+    }
+}
+
+Thread *
+AddressSpace::GetNextSharer(unsigned int vpn) const
+{
+    ASSERT(vpn < numPages);
+    return pages[vpn].nextSharer;
+}
+
+void
+AddressSpace::SetNextSharer(unsigned int vpn, Thread *t)
+{
+    ASSERT(vpn < numPages);
+    pages[vpn].nextSharer = t;
+}
+
+bool
+AddressSpace::IsSharedText(unsigned int vpn) const
+{
+#ifdef VMEM
+    return exe->GetCodeAddr() == 0
+             && (vpn + 1) * PAGE_SIZE <= exe->GetCodeSize();
+#else
+    return false;
+#endif
+}
+
+/// Slots are only taken once pages are written out, but the reservation
+/// makes sure there are enough of them left by then.
+bool
+AddressSpace::HasSwapReserved() const
+{
+#ifdef SWAP
+    return swapReserved;
+#else
+    return true;
+#endif
+}
+
+bool
+AddressSpace::IsCopyOnWrite(unsigned int vpn) const
+{
+    return vpn < numPages && pages[vpn].copyOnWrite;
+}
+
+bool
+AddressSpace::IsValidPage(unsigned int vpn) const
+{
+    return vpn < numPages && pageTable[vpn].valid;
+}
+
+PageBacking
+AddressSpace::GetBacking(unsigned int vpn) const
+{
+    ASSERT(vpn < numPages);
+    return pages[vpn].backing;
+}
+
+/// Does the range of `size` bytes at `addr` overlap page `vpn`?
+static bool
+Overlaps(unsigned int vpn, uint32_t addr, uint32_t size)
+{
+    return size > 0 && addr < (vpn + 1) * PAGE_SIZE
+             && vpn * PAGE_SIZE < addr + size;
+}
+
+/// Pages with any code or initialized data in them are read from the
+/// executable; the rest of the program (uninitialized data and the stack)
+/// starts out as zeros.
+PageBacking
+AddressSpace::InitialBacking(unsigned int vpn) const
+{
+    if (Overlaps(vpn, exe->GetCodeAddr(), exe->GetCodeSize())
+          || Overlaps(vpn, exe->GetInitDataAddr(), exe->GetInitDataSize())) {
+        return BACKING_EXECUTABLE;
+    }
+    return BACKING_ZERO;
+}
+
+void
+AddressSpace::ClearDescriptor(PageDescriptor *page, PageBacking backing)
+{
+    page->backing = backing;
+    page->file = nullptr;
+    page->nextSharer = nullptr;
+    page->copyOnWrite = false;
+    page->prefetched = false;
+    #ifdef SWAP
+        // Slots are only taken when pages get swapped out.
+        page->swapSlot = NO_SWAP_SLOT;
+    #endif
+}
+
+void
+AddressSpace::Resize(unsigned n)
+{
+    ASSERT(n >= programPages);
+
+    TranslationEntry *newPageTable = new TranslationEntry[n];
+    PageDescriptor *newPages = new PageDescriptor[n];
+    for (unsigned i = 0; i < n; i++) {
+        if (i < numPages) {
+            newPageTable[i] = pageTable[i];
+            newPages[i] = pages[i];
+            continue;
+        }
+        newPageTable[i].virtualPage  = i;
+        newPageTable[i].physicalPage = NOT_RESIDENT;
+        newPageTable[i].valid        = false;
+        newPageTable[i].use          = false;
+        newPageTable[i].dirty        = false;
+        newPageTable[i].readOnly     = false;
+        ClearDescriptor(&newPages[i], BACKING_ZERO);
+    }
+    for (unsigned i = n; i < numPages; i++) {
+        ASSERT(pageTable[i].physicalPage < 0 && pages[i].file == nullptr);
+    }
+
+    delete [] pageTable;
+    delete [] pages;
+    pageTable = newPageTable;
+    pages = newPages;
+    numPages = n;
+}
+
+/// The mapping goes in the first run of unused pages past the program that
+/// is long enough, or else at the end, growing the page table.
+unsigned
+AddressSpace::Mmap(OpenFile *file, unsigned offset, unsigned size)
+{
+    ASSERT(file != nullptr);
+    ASSERT(offset % PAGE_SIZE == 0);
+    ASSERT(size > 0);
+
+    MappedFile *m = new MappedFile;
+    m->file = file;
+    m->offset = offset;
+    m->size = size;
+    m->numPages = DivRoundUp(size, PAGE_SIZE);
+
+    lockCoremap->Acquire();
+    unsigned first = programPages;
+    for (unsigned i = programPages; i < numPages && i < first + m->numPages;
+         i++) {
+        if (pageTable[i].valid) {
+            first = i + 1;
+        }
+    }
+    if (first + m->numPages > numPages) {
+        Resize(first + m->numPages);
+    }
+    m->firstPage = first;
+    for (unsigned i = first; i < first + m->numPages; i++) {
+        pageTable[i].physicalPage = NOT_RESIDENT;
+        pageTable[i].valid = true;
+        pageTable[i].dirty = false;
+        pages[i].backing = BACKING_FILE;
+        pages[i].file = m;
+    }
+    lockCoremap->Release();
+
+    DEBUG('z', "Mapped %u bytes at offset %u to virtual page %u\n",
+          size, offset, first);
+    return first * PAGE_SIZE;
+}
+
+bool
+AddressSpace::Munmap(unsigned addr)
+{
+    unsigned vpn = addr / PAGE_SIZE;
+    if (addr % PAGE_SIZE != 0 || vpn >= numPages
+          || pages[vpn].file == nullptr || pages[vpn].file->firstPage != vpn) {
+        return false;
+    }
+
+    MappedFile *m = pages[vpn].file;
+    lockCoremap->Acquire();
+    for (unsigned i = vpn; i < vpn + m->numPages; i++) {
+        int frame = SettledFrame(i);
+        if (frame >= 0) {
+            EvictPage(i);
+            if (pageTable[i].dirty) {
+                WriteBack(m, i, frame);
+            }
+            usedPages->Unmap(frame, thread);
+        }
+        pageTable[i].physicalPage = NOT_RESIDENT;
+        pageTable[i].valid = false;
+        ClearDescriptor(&pages[i], BACKING_ZERO);
+    }
+    // Give back unused pages at the end.
+    unsigned n = numPages;
+    while (n > programPages && !pageTable[n - 1].valid) {
+        n--;
+    }
+    if (n < numPages) {
+        Resize(n);
+    }
+    lockCoremap->Release();
+
+    delete m;
+    return true;
+}
+
+void
+AddressSpace::WriteBack(const MappedFile *m, unsigned int vpn, unsigned frame)
+{
+    ASSERT(m != nullptr);
+
+    unsigned position = (vpn - m->firstPage) * PAGE_SIZE;
+    unsigned length = m->size - position < PAGE_SIZE ? m->size - position
+                                                     : PAGE_SIZE;
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    DEBUG('z', "Writing virtual page %u back to its file\n", vpn);
+    m->file->WriteAt(&mainMemory[frame * PAGE_SIZE], length,
+                     m->offset + position);
+}
+
+int
+AddressSpace::SettledFrame(unsigned int vpn)
+{
+    while (pageTable[vpn].physicalPage >= 0
+             && usedPages->IsPinned(pageTable[vpn].physicalPage)) {
+        usedPages->WaitUnpinned();
+    }
+    return pageTable[vpn].physicalPage;
+}
+
+/// Give the page at `vpn` a frame of its own, if it still shares one, and
+/// let it be written.
+///
+/// If the page is not resident (it may have been evicted while waiting for
+/// `lockCoremap`), nothing is done: the write faults it in again, and then
+/// comes back here.
+bool
+AddressSpace::CopyOnWrite(unsigned int vpn)
+{
+    ASSERT(IsCopyOnWrite(vpn));
+
+    TranslationEntry *row = &pageTable[vpn];
+    lockCoremap->Acquire();
+    if (row->physicalPage >= 0 && usedPages->GetRefs(row->physicalPage) > 1
+          && usedPages->CountClear() == 0 && !GetSpace()) {
+        lockCoremap->Release();
+        return false;
+    }
+    int frame = row->physicalPage;
+    if (frame < 0) {
+        lockCoremap->Release();
+        return true;
+    }
+    if (usedPages->GetRefs(frame) > 1) {
+        int copy = usedPages->Find(vpn, currentThread);
+        ASSERT(copy >= 0);
+        #ifdef SWAP
+            pageoutDaemon->Check();
+        #endif
+        DEBUG('z', "Copying virtual page %u from frame %d to %d\n",
+              vpn, frame, copy);
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        memcpy(&mainMemory[copy * PAGE_SIZE], &mainMemory[frame * PAGE_SIZE],
+               PAGE_SIZE);
+        stats->numPageCopies++;
+        usedPages->Unmap(frame, currentThread);
+        row->physicalPage = copy;
+    }
+    #ifdef SWAP
+        // The page is about to differ from the copy in swap, which others
+        // may still need.  From now on it is only in memory, and being
+        // dirty, it gets a slot of its own when evicted.
+        if (pages[vpn].swapSlot != NO_SWAP_SLOT) {
+            swapArea->Free(pages[vpn].swapSlot);
+            pages[vpn].swapSlot = NO_SWAP_SLOT;
+            pages[vpn].backing = BACKING_ZERO;
+        }
+    #endif
+    pages[vpn].copyOnWrite = false;
+    row->readOnly = false;
+    row->dirty = true;
+
+    TranslationEntry *e = GetTlbEntry(vpn);
+    if (e != nullptr) {
+        e->physicalPage = row->physicalPage;
+        e->readOnly = false;
+        e->dirty = true;
+        machine->GetMMU()->InvalidateTranslation(vpn);
+    }
+    lockCoremap->Release();
+    return true;
 }
 
 Thread *
@@ -243,91 +682,473 @@ AddressSpace::GetTranslate(unsigned int vpn) {
     return &pageTable[vpn];
 }
 
-void
-AddressSpace::MarkSwap(unsigned int vpn) {
-    pageTable[vpn].physicalPage = SWAP_VALUE;
-}
-
-void
-AddressSpace::MarkNotAllocate(unsigned int vpn) {
-    pageTable[vpn].physicalPage = NOT_ALLOCATE_VALUE;
-}
+// While a page is in the TLB, its entry there holds the live copy of the
+// use and dirty bits.
 
 bool
 AddressSpace::GetUse(unsigned int vpn) {
-    return pageTable[vpn].use == 1;
+    TranslationEntry *e = GetTlbEntry(vpn);
+    return e != nullptr ? e->use : pageTable[vpn].use == 1;
 }
 
 bool
 AddressSpace::GetDirty(unsigned int vpn) {
-    return pageTable[vpn].dirty == 1;
+    TranslationEntry *e = GetTlbEntry(vpn);
+    return e != nullptr ? e->dirty : pageTable[vpn].dirty == 1;
 }
 
 void
 AddressSpace::ResetUse(unsigned int vpn) {
     pageTable[vpn].use = 0;
+    TranslationEntry *e = GetTlbEntry(vpn);
+    if (e != nullptr) {
+        e->use = false;
+    }
 }
 
 void
-AddressSpace::GetSpace() {
-    currentThread->space->SaveState();
-    int victim = usedPages->PickVictim();
-    Thread *t = usedPages->GetThread(victim);
+AddressSpace::ResetDirty(unsigned int vpn) {
+    pageTable[vpn].dirty = 0;
+    TranslationEntry *e = GetTlbEntry(vpn);
+    if (e != nullptr) {
+        e->dirty = false;
+    }
+}
+
+/// Take frame `victim` away from the page it holds, and from every address
+/// space mapping it.  The page must be clean, so nothing is written: it is
+/// still in its swap slot, in its mapped file, in the executable, or all
+/// zeros.  Dirty pages are written back by `Clean` first.
+///
+/// All the address spaces sharing a frame have the same descriptor for
+/// it.  Pages of mapped files are never shared.
+void
+AddressSpace::Evict(unsigned victim) {
+    Thread *first = usedPages->GetThread(victim);
     int vpn = usedPages->GetVPN(victim);
+    #ifdef VMEM
+        if (usedPages->IsCached(victim)) {
+            pageCache->Remove(victim);
+        }
+    #endif
     usedPages->Clear(victim);
-    if(t->space->GetDirty(vpn)) {
+    stats->numPageEvictions++;
+
+    for (Thread *t = first; t != nullptr; t = t->space->pages[vpn].nextSharer) {
+        PageDescriptor *page = &t->space->pages[vpn];
+        t->space->EvictPage(vpn);
+        ASSERT(!t->space->pageTable[vpn].dirty);
+        if (page->prefetched) {
+            // Brought in by fault-around for nothing.
+            page->prefetched = false;
+            stats->numFaultAroundMisses++;
+        }
+    }
+    if (first == nullptr) {
+        return;  // A code page kept only by the page cache.
+    }
+    if (first->space->pages[vpn].backing == BACKING_FILE) {
+        ASSERT(first->space->pages[vpn].nextSharer == nullptr);
+        first->space->pageTable[vpn].physicalPage = NOT_RESIDENT;
+        return;
+    }
+    #ifdef SWAP
+        int slot = first->space->pages[vpn].swapSlot;
+    #endif
+
+    Thread *next;
+    for (Thread *t = first; t != nullptr; t = next) {
+        AddressSpace *space = t->space;
+        PageDescriptor *page = &space->pages[vpn];
+        next = page->nextSharer;
+        page->nextSharer = nullptr;
+        #ifdef SWAP
+            ASSERT(page->swapSlot == NO_SWAP_SLOT || page->swapSlot == slot);
+            page->swapSlot = slot;
+            if (slot != NO_SWAP_SLOT) {
+                page->backing = BACKING_SWAP;
+            }
+        #endif
+        space->pageTable[vpn].physicalPage = NOT_RESIDENT;
+    }
+}
+
+/// A page of a mapped file is written to the file.  Any other page is
+/// written to its slot in the swap area, which it gets the first time it
+/// is written there and keeps from then on; every address space sharing
+/// the frame gets a share of the slot.
+///
+/// The frame is pinned, and `lockCoremap` released, during the write.  The
+/// dirty bits are cleared before, so that writes to the page meanwhile make
+/// it dirty again.
+bool
+AddressSpace::Clean(unsigned frame) {
+    Thread *first = usedPages->GetThread(frame);
+    int vpn = usedPages->GetVPN(frame);
+    ASSERT(first != nullptr);
+
+    PageDescriptor *page = &first->space->pages[vpn];
+    bool toFile = page->backing == BACKING_FILE;
+    #ifdef SWAP
+        int slot = page->swapSlot;
+        if (!toFile && slot == NO_SWAP_SLOT) {
+            slot = swapArea->Allocate();
+            if (slot == NO_SWAP_SLOT) {
+                return false;
+            }
+            for (Thread *t = first; t != nullptr;
+                 t = t->space->pages[vpn].nextSharer) {
+                ASSERT(t->space->pages[vpn].swapSlot == NO_SWAP_SLOT);
+                if (t != first) {
+                    swapArea->Share(slot);
+                }
+                t->space->pages[vpn].swapSlot = slot;
+            }
+        }
+    #else
+        if (!toFile) {
+            return false;  // Nowhere to write it.
+        }
+    #endif
+
+    for (Thread *t = first; t != nullptr; t = t->space->pages[vpn].nextSharer) {
+        t->space->ResetDirty(vpn);
+    }
+    usedPages->Pin(frame);
+    if (toFile) {
+        ASSERT(page->nextSharer == nullptr);
+        MappedFile *m = page->file;
+        lockCoremap->Release();
+        WriteBack(m, vpn, frame);
+        lockCoremap->Acquire();
+        usedPages->Unpin(frame);
+        return true;
+    }
+    #ifdef SWAP
+        ASSERT(!first->space->IsSharedText(vpn));
+        // Hold a share of the slot, so that it is not given to some other
+        // page before the write is done, whatever happens to this one.
+        swapArea->Share(slot);
         stats->numSwaps++;
-        t->space->MarkSwap(vpn);
-        OpenFile *swapFile = t->space->swap;
+        DEBUG('z', "Swaping virtual page %d from frame %u to slot %d\n",
+              vpn, frame, slot);
         char *mainMemory = machine->GetMMU()->mainMemory;
-        DEBUG('z', "Swaping virtual page %d from 0x%X\n", vpn, t);
-        swapFile->WriteAt(&mainMemory[victim * PAGE_SIZE], PAGE_SIZE, PAGE_SIZE * vpn);
-    } else {
-        t->space->MarkNotAllocate(vpn);
+        lockCoremap->Release();
+        swapArea->Write(slot, &mainMemory[frame * PAGE_SIZE]);
+        lockCoremap->Acquire();
+        swapArea->Free(slot);
+    #endif
+    usedPages->Unpin(frame);
+    return true;
+}
+
+/// A dirty victim that cannot be written back is pinned, to keep it out of
+/// the way, and the replacement policy asked for another, until some frame
+/// is freed or cleaned, or none is left.
+ReclaimResult
+AddressSpace::Reclaim() {
+    ReclaimResult result = RECLAIM_FAILED;
+    unsigned *skipped = nullptr;
+    unsigned numSkipped = 0;
+
+    while (usedPages->HasEvictable()) {
+        unsigned victim = usedPages->PickVictim();
+        if (!usedPages->GetDirty(victim)) {
+            Evict(victim);
+            result = RECLAIM_EVICTED;
+            break;
+        }
+        if (Clean(victim)) {
+            result = RECLAIM_CLEANED;
+            break;
+        }
+        if (skipped == nullptr) {
+            skipped = new unsigned [usedPages->GetSize()];
+        }
+        usedPages->Pin(victim);
+        skipped[numSkipped++] = victim;
+    }
+
+    for (unsigned i = 0; i < numSkipped; i++) {
+        usedPages->Unpin(skipped[i]);
     }
-    if(t == currentThread) {
-        for(unsigned int i = 0; i < TLB_SIZE; i++) {
-            if(machine->GetMMU()->tlb[i].virtualPage == vpn && machine->GetMMU()->tlb[i].valid) {
-                machine->GetMMU()->tlb[i].valid = false;
+    delete [] skipped;
+    return result;
+}
+
+/// If every frame is pinned, wait for one to be let go.  If the frames not
+/// pinned cannot be reclaimed, those pinned may still be, once let go, so
+/// wait as well; only when nothing is pinned is there no way out.
+bool
+AddressSpace::GetSpace() {
+    while (usedPages->CountClear() == 0) {
+        if (usedPages->HasEvictable() && Reclaim() != RECLAIM_FAILED) {
+            continue;
+        }
+        if (!usedPages->HasPinned()) {
+            return false;
+        }
+        usedPages->WaitUnpinned();
+    }
+    return true;
+}
+
+/// Frames fault-around leaves free, so that it never causes evictions.
+static unsigned
+FaultAroundReserve()
+{
+#ifdef SWAP
+    unsigned lowWater = pageoutDaemon->GetLowWater();
+    return lowWater > 0 ? lowWater : 1;
+#else
+    return 1;
+#endif
+}
+
+/// Return how many pages after `vpn` to bring in along with it.
+///
+/// The window doubles while faults move forward past what was brought in
+/// last time, that is, while the program runs through its pages in order,
+/// and halves on any other fault.
+unsigned
+AddressSpace::NextFaultWindow(unsigned int vpn)
+{
+    if (lastFault >= 0) {
+        if (vpn > (unsigned) lastFault
+              && vpn <= (unsigned) lastFault + faultWindow + 1) {
+            faultWindow = faultWindow == 0 ? 1 : 2 * faultWindow;
+            if (faultWindow > FAULT_AROUND_MAX_WINDOW) {
+                faultWindow = FAULT_AROUND_MAX_WINDOW;
             }
+        } else {
+            faultWindow /= 2;
         }
     }
+    lastFault = vpn;
+    return faultWindow;
+}
+
+/// Can page `next` be brought in along with page `vpn`?  It must not be
+/// resident, and be kept in the same place: the executable, the same file,
+/// the swap slot right after, or nowhere (zero-filled pages save a fault
+/// each too).  A frame must also be free to spare.
+bool
+AddressSpace::CanFaultAround(unsigned int vpn, unsigned int next) const
+{
+    if (next >= numPages || !pageTable[next].valid
+          || pageTable[next].physicalPage >= 0
+          || pages[next].backing != pages[vpn].backing
+          || usedPages->CountClear() <= FaultAroundReserve()) {
+        return false;
+    }
+    switch (pages[vpn].backing) {
+        case BACKING_EXECUTABLE:
+        case BACKING_ZERO:
+            return true;
+        case BACKING_FILE:
+            return pages[next].file == pages[vpn].file;
+#ifdef SWAP
+        case BACKING_SWAP:
+            return pages[next].swapSlot
+                     == pages[vpn].swapSlot + (int) (next - vpn);
+#endif
+        default:
+            return false;
+    }
 }
 
 void
+AddressSpace::UsePrefetched(unsigned int vpn)
+{
+    if (pages[vpn].prefetched) {
+        pages[vpn].prefetched = false;
+        stats->numFaultAroundHits++;
+    }
+}
+
+/// Bring page `vpn` back from swap, along with the pages after it that
+/// are in the slots after its own, in a single read.
+///
+/// The frames are taken, and pinned, with `lockCoremap` held; the read is
+/// done without it, and the pages mapped once they are in.
+bool
 AddressSpace::ReturnSwap(unsigned int vpn) {
-    stats->numRestoreSwaps++;
+#ifdef SWAP
+    stats->numPageFaults++;
     lockCoremap->Acquire();
     if(!(usedPages->CountClear() >= 1)) {
         DEBUG('z', "No hay paginas fisicas disponibles\n");
-        GetSpace();
+        if (!GetSpace()) {
+            lockCoremap->Release();
+            return false;
+        }
+    }
+    int frames[FAULT_AROUND_MAX_WINDOW + 1];
+    frames[0] = usedPages->Find(vpn, currentThread);
+    usedPages->Pin(frames[0]);
+    pageoutDaemon->Check();
+    DEBUG('z', "Restoring virtual page %d\n", vpn);
+    unsigned window = NextFaultWindow(vpn);
+    unsigned count = 1;
+    while (count <= window && CanFaultAround(vpn, vpn + count)) {
+        frames[count] = usedPages->Find(vpn + count, currentThread);
+        usedPages->Pin(frames[count]);
+        pageoutDaemon->Check();
+        pages[vpn + count].prefetched = true;
+        count++;
     }
-    pageTable[vpn].physicalPage = usedPages->Find(vpn, currentThread);
+    stats->numRestoreSwaps += count;
+    stats->numFaultAroundPages += count - 1;
+    int slot = pages[vpn].swapSlot;
     lockCoremap->Release();
+
     char *mainMemory = machine->GetMMU()->mainMemory;
-    DEBUG('z', "Restoring virtual page %d\n", vpn);
-    swap->ReadAt(&mainMemory[pageTable[vpn].physicalPage * PAGE_SIZE], PAGE_SIZE, PAGE_SIZE * vpn);
+    if (count == 1) {
+        swapArea->Read(slot, &mainMemory[frames[0] * PAGE_SIZE]);
+    } else {
+        DEBUG('z', "Restoring %u more pages with it\n", count - 1);
+        char *buffer = new char [count * PAGE_SIZE];
+        swapArea->Read(slot, buffer, count);
+        for (unsigned i = 0; i < count; i++) {
+            memcpy(&mainMemory[frames[i] * PAGE_SIZE], &buffer[i * PAGE_SIZE],
+                   PAGE_SIZE);
+        }
+        delete [] buffer;
+    }
+
+    lockCoremap->Acquire();
+    for (unsigned i = 0; i < count; i++) {
+        MapFrame(vpn + i, frames[i]);
+    }
+    lockCoremap->Release();
+    return true;
+#else
+    ASSERT(false);  // Nothing is ever swapped out.
+    return false;
+#endif
 }
 
-void
+/// Bring page `vpn` in from the executable or its mapped file, or fill it
+/// with zeros, along with the pages after it kept in the same place, as
+/// many as the fault-around window allows.
+///
+/// As in `ReturnSwap`, the pages are read with `lockCoremap` released.
+bool
 AddressSpace::AllocatePage(unsigned int vpn) {
+    stats->numPageFaults++;
     lockCoremap->Acquire();
+    unsigned window = NextFaultWindow(vpn);
+    int frames[FAULT_AROUND_MAX_WINDOW + 1];
+    unsigned count = 0;
+    if (!TakeFrame(vpn, &frames[count++])) {
+        lockCoremap->Release();
+        return false;
+    }
+    // Fault-around only takes frames that are free.
+    for (unsigned i = vpn + 1;
+         i <= vpn + window && CanFaultAround(vpn, i);
+         i++) {
+        bool taken = TakeFrame(i, &frames[count++]);
+        ASSERT(taken);
+        pages[i].prefetched = true;
+        stats->numFaultAroundPages++;
+    }
+    lockCoremap->Release();
+
+    for (unsigned i = 0; i < count; i++) {
+        if (frames[i] >= 0) {
+            FillFrame(vpn + i, frames[i]);
+        }
+    }
+
+    lockCoremap->Acquire();
+    for (unsigned i = 0; i < count; i++) {
+        if (frames[i] >= 0) {
+            MapFrame(vpn + i, frames[i]);
+        }
+    }
+    lockCoremap->Release();
+    return true;
+}
+
+bool
+AddressSpace::TakeFrame(unsigned int vpn, int *frame) {
+    #ifdef VMEM
+        if (IsSharedText(vpn)) {
+            int cached = pageCache->Lookup(exe->GetFileId(), vpn);
+            if (cached >= 0) {
+                DEBUG('z', "Sharing code page %u in frame %d\n", vpn, cached);
+                stats->numPageCacheHits++;
+                usedPages->Share(cached, currentThread);
+                pageTable[vpn].physicalPage = cached;
+                *frame = -1;
+                return true;
+            }
+        }
+    #endif
     if(usedPages->CountClear() == 0) {
         DEBUG('z', "No hay paginas fisicas disponibles\n");
         #ifdef SWAP
-            GetSpace();
+            if (!GetSpace()) {
+                return false;
+            }
         #else
             ASSERT(false);
         #endif
     }
     DEBUG('z', "ALLOCATE\n");
-    pageTable[vpn].physicalPage = usedPages->Find(vpn, currentThread);
-    lockCoremap->Release();
+    *frame = usedPages->Find(vpn, currentThread);
+    usedPages->Pin(*frame);
+    // A fresh copy, of our own.
+    pages[vpn].copyOnWrite = false;
+    pageTable[vpn].readOnly = IsSharedText(vpn);
+    #ifdef SWAP
+        pageoutDaemon->Check();
+    #endif
+    return true;
+}
+
+/// Code pages go into the page cache, unless some other process loaded the
+/// same page meanwhile; this copy is then kept private.
+void
+AddressSpace::MapFrame(unsigned int vpn, unsigned frame) {
+    pageTable[vpn].physicalPage = frame;
+    #ifdef VMEM
+        if (IsSharedText(vpn)) {
+            FileId file = exe->GetFileId();
+            if (pageCache->Lookup(file, vpn) < 0) {
+                pageCache->Insert(file, vpn, frame);
+                usedPages->SetCached(frame);
+            }
+        }
+    #endif
+    usedPages->Unpin(frame);
+}
+
+void
+AddressSpace::FillFrame(unsigned int vpn, unsigned frame) {
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    if (pages[vpn].backing == BACKING_ZERO) {
+        memset(&mainMemory[frame * PAGE_SIZE], 0, PAGE_SIZE);
+        stats->numZeroFills++;
+        return;
+    }
+    if (pages[vpn].backing == BACKING_FILE) {
+        MappedFile *m = pages[vpn].file;
+        unsigned position = (vpn - m->firstPage) * PAGE_SIZE;
+        unsigned length = m->size - position < PAGE_SIZE ? m->size - position
+                                                         : PAGE_SIZE;
+        char *into = &mainMemory[frame * PAGE_SIZE];
+        memset(into, 0, PAGE_SIZE);
+        DEBUG('z', "Reading virtual page %u from its file\n", vpn);
+        m->file->ReadAt(into, length, m->offset + position);
+        return;
+    }
+    ASSERT(pages[vpn].backing == BACKING_EXECUTABLE);
     unsigned int toAllocate = PAGE_SIZE;
     unsigned int cantRead;
     unsigned int virtualAddr = vpn * PAGE_SIZE;
-    unsigned int phyAddr = TranslateAddr(virtualAddr);
-    char *mainMemory = machine->GetMMU()->mainMemory;
+    unsigned int phyAddr = frame * PAGE_SIZE;
     uint32_t codeSize = exe->GetCodeSize();
     uint32_t dataSize = exe->GetInitDataSize();
     uint32_t dataAddr = exe->GetInitDataAddr();
@@ -346,8 +1167,8 @@ AddressSpace::AllocatePage(unsigned int vpn) {
     }
     unsigned int endData = codeSize + dataSize;
     if (toAllocate > 0 && dataSize > 0 && virtualAddr < endData) {
-        phyAddr = TranslateAddr(virtualAddr);
-        unsigned int nextPage = (pageTable[vpn].physicalPage + 1) * PAGE_SIZE;
+        phyAddr = frame * PAGE_SIZE + virtualAddr % PAGE_SIZE;
+        unsigned int nextPage = (frame + 1) * PAGE_SIZE;
         unsigned int space = nextPage - phyAddr;
         if(space == PAGE_SIZE) {
             if(toAllocate == PAGE_SIZE) {
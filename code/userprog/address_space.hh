@@ -22,11 +22,65 @@
 #include "threads/thread.hh"
 #include "executable.hh"
 
+#ifdef SWAP
+#include "vmem/swap_area.hh"
+#endif
+
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
-const int SWAP_VALUE = -1;
-const int NOT_ALLOCATE_VALUE = -2;
+
+/// Physical page of a page that is not in memory; its descriptor tells
+/// where it is kept instead.
+const int NOT_RESIDENT = -1;
+
+/// A range of an open file mapped into an address space by `Mmap`.
+struct MappedFile {
+    OpenFile *file;
+    unsigned offset;     ///< Position in the file of the first byte mapped.
+    unsigned size;       ///< Number of bytes mapped.
+    unsigned firstPage;  ///< Virtual page the range starts at.
+    unsigned numPages;
+};
+
+/// Fault-around: pages brought in after the faulting one, at first and at
+/// most.
+const unsigned FAULT_AROUND_INITIAL_WINDOW = 2;
+const unsigned FAULT_AROUND_MAX_WINDOW = 16;
+
+/// Where a page is kept while it is not in memory.
+enum PageBacking {
+    BACKING_EXECUTABLE,  ///< The executable: code or initialized data.
+    BACKING_ZERO,        ///< Nowhere: it is all zeros (bss and stack).
+    BACKING_SWAP,        ///< Its slot in the swap area.
+    BACKING_FILE         ///< A mapped file.
+};
+
+/// What `AddressSpace::Reclaim` managed to do.
+enum ReclaimResult {
+    RECLAIM_EVICTED,  ///< A frame was freed.
+    RECLAIM_CLEANED,  ///< A dirty page was written back, to go next time.
+    RECLAIM_FAILED    ///< Every page left was dirty, with nowhere to go.
+};
 
 class Thread;
+
+/// What an address space keeps about each virtual page, besides its
+/// translation.
+struct PageDescriptor {
+    PageBacking backing;
+    MappedFile *file;     ///< File mapped there, for `BACKING_FILE`.
+#ifdef SWAP
+    int swapSlot;         ///< Slot in the swap area, or `NO_SWAP_SLOT`.
+#endif
+
+    /// Next thread in the chain of those mapping the same frame, or null.
+    Thread *nextSharer;
+
+    bool copyOnWrite;     ///< Read-only until copied.
+
+    /// Brought in by fault-around, and not used yet.
+    bool prefetched;
+};
+
 class AddressSpace {
 public:
 
@@ -39,9 +93,14 @@ public:
     ///
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
-    ///   program; it contains the object code to load into memory.
+    ///   program; it contains the object code to load into memory.  Its
+    ///   code pages are shared with other processes running the same file.
     AddressSpace(OpenFile *executable_file, Thread *hilo=nullptr, char **args = nullptr);
 
+    /// Create a copy-on-write duplicate of `parent`, for the thread `child`
+    /// created by `Fork`.  The executable is shared with the parent.
+    AddressSpace(AddressSpace *parent, Thread *child);
+
     /// De-allocate an address space.
     ~AddressSpace();
 
@@ -59,28 +118,173 @@ public:
     unsigned int GetPhyPage(unsigned int virtualAddr);
     unsigned int GetOffset(unsigned int virtualAddr);
     TranslationEntry *GetTranslate(unsigned int vpn);
-    void AllocatePage(unsigned int vpn);
 
-    void MarkSwap(unsigned int vpn);
-    void MarkNotAllocate(unsigned int vpn);
-    void GetSpace();
-    void ReturnSwap(unsigned int vpn);
-    OpenFile *swap;
+    /// Bring in page `vpn`, which is not in swap.  Return false if memory
+    /// ran out; see `GetSpace`.
+    bool AllocatePage(unsigned int vpn);
+
+    /// Note that the page at `vpn` is being used; if fault-around brought
+    /// it in, that counts as a hit.
+    void UsePrefetched(unsigned int vpn);
+
+    /// Make sure some frame is free, evicting pages as needed.  Return
+    /// false if none can be: every page in memory is dirty and the swap
+    /// area is full.  Called with `lockCoremap` held, which may be released
+    /// meanwhile.
+    static bool GetSpace();
+
+    /// Take a step towards freeing a frame: evict the page the replacement
+    /// policy chooses if it is clean, or else write it back, so that it can
+    /// be evicted without waiting next time.  Called with `lockCoremap`
+    /// held, and some frame evictable.
+    static ReclaimResult Reclaim();
+
+    /// Write back the dirty page in frame `frame`, keeping it in memory.
+    /// Return false, leaving it dirty, if there is nowhere to write it.
+    static bool Clean(unsigned frame);
+
+    /// Bring page `vpn` back from swap.  Return false if memory ran out.
+    bool ReturnSwap(unsigned int vpn);
 
     void ResetUse(unsigned int vpn);
+    void ResetDirty(unsigned int vpn);
     bool GetDirty(unsigned int vpn);
     bool GetUse(unsigned int vpn);
 
+    /// Forget the translation of `vpn`, writing back its use and dirty bits
+    /// if it is in the TLB.  Called before its frame is taken away.
+    void EvictPage(unsigned int vpn);
+
+    /// Copy the use and dirty bits of TLB entry `e` back into the page table
+    /// of the address space it belongs to.
+    static void SaveTlbEntry(const TranslationEntry *e);
+
+    /// Is the page at `vpn` shared with a forked address space, waiting to
+    /// be copied when written?
+    bool IsCopyOnWrite(unsigned int vpn) const;
+
+    /// Give the page at `vpn` a private, writable frame.  Return false if
+    /// memory ran out.
+    bool CopyOnWrite(unsigned int vpn);
+
+    /// Map `size` bytes of `file`, starting at `offset`, which must be a
+    /// multiple of the page size, into unused virtual pages past the
+    /// program, and return the address they start at.
+    ///
+    /// Pages are read from the file the first time they are touched, and
+    /// written back when they are evicted dirty or unmapped.  They are not
+    /// inherited by `Fork`.
+    unsigned Mmap(OpenFile *file, unsigned offset, unsigned size);
+
+    /// Remove the mapping starting at `addr`, writing back its dirty pages.
+    /// Return false if no mapping starts there.
+    bool Munmap(unsigned addr);
+
+    /// Could the address space reserve a swap slot for every page of the
+    /// program, should they all be evicted dirty?  No program is started in
+    /// it otherwise.
+    bool HasSwapReserved() const;
+
+    /// May the program use the page at `vpn`?
+    bool IsValidPage(unsigned int vpn) const;
+
+    /// Where the page at `vpn` is kept while not in memory.
+    PageBacking GetBacking(unsigned int vpn) const;
+
+    /// Next thread mapping the same frame as this address space does at
+    /// `vpn`; see `Coremap::Share`.
+    Thread *GetNextSharer(unsigned int vpn) const;
+    void SetNextSharer(unsigned int vpn, Thread *t);
+
 private:
 
+    /// Return the TLB entry currently mapping `vpn`, if any.
+    TranslationEntry *GetTlbEntry(unsigned int vpn);
+
+    /// Is `vpn` a page holding nothing but code, to be shared read-only
+    /// through the page cache?
+    bool IsSharedText(unsigned int vpn) const;
+
+
+    /// Give page `vpn` a frame to be filled, pinned, in `*frame`; or map
+    /// it to the frame of the page cache holding it and set `*frame` to -1.
+    /// Return false if memory ran out.  Called with `lockCoremap` held,
+    /// which may be released meanwhile.
+    bool TakeFrame(unsigned int vpn, int *frame);
+
+    /// Fill frame `frame` with page `vpn`, from the executable or its
+    /// mapped file, or with zeros.  Called without `lockCoremap`.
+    void FillFrame(unsigned int vpn, unsigned frame);
+
+    /// Map page `vpn` to frame `frame`, now filled, and unpin the frame.
+    void MapFrame(unsigned int vpn, unsigned frame);
+
+    /// Return the frame holding `vpn`, or `NOT_RESIDENT`, once it is not
+    /// pinned.  Called with `lockCoremap` held, which may be released
+    /// meanwhile.
+    int SettledFrame(unsigned int vpn);
+
+    /// Take frame `victim` away from the clean page it holds.
+    static void Evict(unsigned victim);
+
+    /// Where page `vpn` of the program is kept before it is first loaded.
+    PageBacking InitialBacking(unsigned int vpn) const;
+
+    /// Reset `page` to an unshared, unmapped page kept in `backing`.
+    static void ClearDescriptor(PageDescriptor *page, PageBacking backing);
+
+    /// Adjust the fault-around window for a fault at `vpn`, and return it.
+    unsigned NextFaultWindow(unsigned int vpn);
+
+    /// Can page `next` be brought in along with `vpn`?
+    bool CanFaultAround(unsigned int vpn, unsigned int next) const;
+
+    /// Grow or shrink the page table to `n` pages; new ones are unused.
+    /// Must be called with `lockCoremap` held.
+    void Resize(unsigned n);
+
+    /// Write page `vpn`, mapped from `m`, back from frame `frame`.
+    static void WriteBack(const MappedFile *m, unsigned int vpn,
+                          unsigned frame);
+
+    /// Get an address space identifier, taking it away from some other
+    /// address space if none is free.
+    void AcquireAsid();
+
+    /// Remove every TLB entry of this address space, writing back their
+    /// bits, and give up its identifier.
+    void ReleaseAsid();
+
+    /// Identifier tagging this address space's TLB entries, or -1 if it
+    /// has none yet.
+    int asid;
+
+    /// Owner of each address space identifier, or null if it is free.
+    static AddressSpace *asidOwners[NUM_ASIDS];
+    static unsigned nextAsidVictim;
+
     /// Assume linear page table translation for now!
     TranslationEntry *pageTable;
     Thread *thread;
     /// Number of pages in the virtual address space.
     unsigned numPages;
+    /// Number of those holding the program and its stack; the rest are
+    /// for mapped files.
+    unsigned programPages;
+#ifdef SWAP
+    /// Whether `programPages` slots are reserved in the swap area.
+    bool swapReserved;
+#endif
     char **initsArgs;
     Executable *exe;
 
+    /// One descriptor per virtual page.
+    PageDescriptor *pages;
+
+    /// Page of the last fault, or -1, and the fault-around window.
+    int lastFault;
+    unsigned faultWindow;
+
 };
 
 
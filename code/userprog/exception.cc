@@ -65,6 +65,16 @@ DefaultHandler(ExceptionType et)
     ASSERT(false);
 }
 
+/// Terminate the current process with `status`, giving back the frames, TLB
+/// entries and swap slots of the program.
+static void
+ExitProcess(int status)
+{
+    delete currentThread->space;
+    currentThread->space = nullptr;
+    currentThread->Finish(status);
+}
+
 void
 StartProcess(void *addressSpace)
 {
@@ -87,6 +97,24 @@ StartProcess(void *addressSpace)
                      // exits by doing the system call `Exit`.
 }
 
+/// Start a process created by `Fork`, with the registers its parent had,
+/// as adjusted by `SC_FORK`.
+static void
+StartForkedProcess(void *registers)
+{
+    ASSERT(registers != nullptr);
+    int *values = (int *) registers;
+
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, values[i]);
+    }
+    delete [] values;
+    currentThread->space->RestoreState();
+
+    machine->Run();
+    ASSERT(false);
+}
+
 /// Handle a system call exception.
 ///
 /// * `et` is the kind of exception.  The list of possible exceptions is in
@@ -168,8 +196,7 @@ SyscallHandler(ExceptionType _et)
 
         case SC_EXIT: {
             int status = machine->ReadRegister(4);
-
-            currentThread->Finish(status);
+            ExitProcess(status);
             break;
         }
 
@@ -276,15 +303,6 @@ SyscallHandler(ExceptionType _et)
                 DEBUG('e', "Error: address to filename string is null.\n");
             }
 
-            int addressArgs = machine->ReadRegister(5);
-            char **args;
-            if (addressArgs == 0) {
-                args = nullptr;
-            }
-            else {
-                args = SaveArgs(addressArgs);
-            }
-
             char filename[50 + 1];
             if (!ReadStringFromUser(filenameAddr,
                                     filename, sizeof filename)) {
@@ -294,9 +312,31 @@ SyscallHandler(ExceptionType _et)
 
             DEBUG('e', "`Exec` requested for file `%s`.\n", filename);
             OpenFile *fileAddr = fileSystem->Open(filename);
+            if (fileAddr == nullptr) {
+                DEBUG('e', "Error: file `%s` not found.\n", filename);
+                machine->WriteRegister(2, -1);
+                break;
+            }
+
+            int addressArgs = machine->ReadRegister(5);
+            char **args;
+            if (addressArgs == 0) {
+                args = nullptr;
+            }
+            else {
+                args = SaveArgs(addressArgs);
+            }
+
             Thread *son = new Thread(filename, true);
-            int key = currentThread->AddSon(son);
             AddressSpace *addressSpace = new AddressSpace(fileAddr, son, args);
+            if (!addressSpace->HasSwapReserved()) {
+                DEBUG('e', "Error: no room in swap for `%s`.\n", filename);
+                delete addressSpace;
+                delete son;
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            int key = currentThread->AddSon(son);
 
             son->Fork(StartProcess, (void *) addressSpace);
 
@@ -306,11 +346,83 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_FORK: {
+            int func = machine->ReadRegister(4);
+            DEBUG('e', "`Fork` requested.\n");
+
+            Thread *son = new Thread(currentThread->GetName(), true);
+            AddressSpace *addressSpace = new AddressSpace(currentThread->space,
+                                                          son);
+            ASSERT(son->space == addressSpace);
+            if (!addressSpace->HasSwapReserved()) {
+                DEBUG('e', "Error: no room in swap for the child.\n");
+                delete addressSpace;
+                delete son;
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            int key = currentThread->AddSon(son);
+
+            // The child goes on after the call, where it returns 0, unless
+            // it is given a function to run.
+            int *registers = new int [NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+                registers[i] = machine->ReadRegister(i);
+            }
+            registers[2] = 0;
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] = registers[PC_REG] + 4;
+            if (func != 0) {
+                registers[PC_REG] = func;
+                registers[NEXT_PC_REG] = func + 4;
+            }
+            son->Fork(StartForkedProcess, (void *) registers);
+
+            machine->WriteRegister(2, key);
+            DEBUG('e', "Fork success.\n");
+            break;
+        }
+
+        case SC_MMAP: {
+            int fid = machine->ReadRegister(4);
+            int offset = machine->ReadRegister(5);
+            int size = machine->ReadRegister(6);
+            DEBUG('e', "`Mmap` requested for id %u.\n", fid);
+
+            OpenFile *file = currentThread->GetFile(fid);
+            int addr = 0;
+            if (file == nullptr) {
+                DEBUG('e', "Error: file %d is not open.\n", fid);
+            } else if (offset < 0 || offset % PAGE_SIZE != 0 || size <= 0) {
+                DEBUG('e', "Error: bad range to map.\n");
+            } else {
+                addr = currentThread->space->Mmap(file, offset, size);
+                DEBUG('e', "`Mmap` success.\n");
+            }
+            machine->WriteRegister(2, addr);
+            break;
+        }
+
+        case SC_MUNMAP: {
+            int addr = machine->ReadRegister(4);
+            DEBUG('e', "`Munmap` requested for address 0x%X.\n", addr);
+            if (currentThread->space->Munmap(addr)) {
+                machine->WriteRegister(2, 0);
+            } else {
+                DEBUG('e', "Error: nothing mapped at 0x%X.\n", addr);
+                machine->WriteRegister(2, -1);
+            }
+            break;
+        }
+
         case SC_JOIN: {
             int spaceInt = machine->ReadRegister(4);
             Thread *son = currentThread->GetSon(spaceInt);
             if(son == nullptr) {
                 DEBUG('e', "Join error: invalid space.\n");
+                machine->WriteRegister(2, -1);
+                break;
             }
             int result = son->Join();
             machine->WriteRegister(2, result);
@@ -331,29 +443,63 @@ GetVirtualPage(int virtualAddr) {
     return virtualAddr / PAGE_SIZE;
 }
 
+/// Save the use and dirty bits of TLB entry `i` into the page table of
+/// whichever address space it belongs to, and drop it.
+static void
+DropTlbEntry(MMU *mmu, unsigned i) {
+    TranslationEntry *e = &mmu->tlb[i];
+    AddressSpace::SaveTlbEntry(e);
+    mmu->InvalidateTranslation(e->virtualPage);
+    e->valid = false;
+}
+
+/// Handle a TLB miss: load the translation of the faulting page into the
+/// TLB, making the page resident first if needed.  A process touching a page
+/// outside its address space, or needing a frame when none can be freed, is
+/// terminated.
+///
+/// No lock is needed around the TLB: the handler can only block while
+/// bringing the page in, and nothing is assumed about the TLB across that;
+/// if some other thread loaded an entry into the chosen slot (or took the
+/// page away again) in the meantime, it is simply dealt with afterwards.
 static void
 PageFaultHandler(ExceptionType _et) {
     stats->numFailures++;
     stats->numHits--;
     int badAddr = machine->ReadRegister(BAD_VADDR_REG);
-    lockTLB->Acquire();
-    TranslationEntry *tlb = machine->GetMMU()->tlb;
-    unsigned int deleteEntry = rand() % TLB_SIZE;
+    MMU *mmu = machine->GetMMU();
+    TranslationEntry *tlb = mmu->tlb;
     unsigned int virtualPage = GetVirtualPage(badAddr);
+    if (!currentThread->space->IsValidPage(virtualPage)) {
+        fprintf(stderr, "Access to unmapped address 0x%X, terminating the"
+                        " process.\n", badAddr);
+        ExitProcess(-1);
+    }
+    unsigned int deleteEntry = mmu->PickTlbVictim(virtualPage);
     TranslationEntry* row = currentThread->space->GetTranslate(virtualPage);
+    if (row->physicalPage >= 0) {
+        currentThread->space->UsePrefetched(virtualPage);
+    }
     if(tlb[deleteEntry].valid) {
-        unsigned int vpn = tlb[deleteEntry].virtualPage;
-        TranslationEntry* oldEntry = currentThread->space->GetTranslate(vpn);
-        oldEntry->use = tlb[deleteEntry].use;
-        oldEntry->readOnly = tlb[deleteEntry].readOnly;
-        oldEntry->dirty = tlb[deleteEntry].dirty;
+        DropTlbEntry(mmu, deleteEntry);
     }
-    if (row->physicalPage == SWAP_VALUE) {
-        currentThread->space->ReturnSwap(virtualPage);
+    while (row->physicalPage < 0) {
+        bool loaded;
+        if (currentThread->space->GetBacking(virtualPage) == BACKING_SWAP) {
+            loaded = currentThread->space->ReturnSwap(virtualPage);
+        } else {
+            loaded = currentThread->space->AllocatePage(virtualPage);
+        }
+        if (!loaded) {
+            fprintf(stderr, "Out of memory at address 0x%X, terminating the"
+                            " process.\n", badAddr);
+            ExitProcess(-1);
+        }
     }
-    if (row->physicalPage == NOT_ALLOCATE_VALUE) {
-        currentThread->space->AllocatePage(virtualPage);
+    if(tlb[deleteEntry].valid) {
+        DropTlbEntry(mmu, deleteEntry);
     }
+    usedPages->Reference(row->physicalPage);
     DEBUG('e', "Entrada a remplazar: %d, vpn: %d, fpn: %d\n", deleteEntry, virtualPage, row->physicalPage);
     tlb[deleteEntry].valid = row->valid;
     tlb[deleteEntry].use = row->use;
@@ -361,7 +507,33 @@ PageFaultHandler(ExceptionType _et) {
     tlb[deleteEntry].readOnly = row->readOnly;
     tlb[deleteEntry].physicalPage = row->physicalPage;
     tlb[deleteEntry].virtualPage = row->virtualPage;
-    lockTLB->Release();
+    tlb[deleteEntry].asid = mmu->asid;
+}
+
+/// Handle a write to a read-only page.
+///
+/// A page shared with a forked process is copied, and the write retried.
+/// Otherwise it is the code of the program, and the process is terminated
+/// with status -1; as it is if no frame can be had for the copy.
+static void
+ReadOnlyHandler(ExceptionType _et)
+{
+    int badAddr = machine->ReadRegister(BAD_VADDR_REG);
+    AddressSpace *space = currentThread->space;
+    unsigned int virtualPage = GetVirtualPage(badAddr);
+
+    if (space->IsCopyOnWrite(virtualPage)) {
+        if (!space->CopyOnWrite(virtualPage)) {
+            fprintf(stderr, "Out of memory at address 0x%X, terminating the"
+                            " process.\n", badAddr);
+            ExitProcess(-1);
+        }
+        return;
+    }
+
+    fprintf(stderr, "Write to read-only address 0x%X, terminating the"
+                    " process.\n", badAddr);
+    ExitProcess(-1);
 }
 
 /// By default, only system calls have their own handler.  All other
@@ -372,7 +544,7 @@ SetExceptionHandlers()
     machine->SetHandler(NO_EXCEPTION,            &DefaultHandler);
     machine->SetHandler(SYSCALL_EXCEPTION,       &SyscallHandler);
     machine->SetHandler(PAGE_FAULT_EXCEPTION,    &PageFaultHandler);
-    machine->SetHandler(READ_ONLY_EXCEPTION,     &DefaultHandler);
+    machine->SetHandler(READ_ONLY_EXCEPTION,     &ReadOnlyHandler);
     machine->SetHandler(BUS_ERROR_EXCEPTION,     &DefaultHandler);
     machine->SetHandler(ADDRESS_ERROR_EXCEPTION, &DefaultHandler);
     machine->SetHandler(OVERFLOW_EXCEPTION,      &DefaultHandler);
@@ -34,12 +34,33 @@ Executable::Executable(OpenFile *new_file)
 
     file = new_file;
     file->ReadAt((char *) &header, sizeof header, 0);
+    users = 1;
 }
 
 Executable::~Executable() {
+    ASSERT(users == 0);
     delete file;
 }
 
+void
+Executable::Share()
+{
+    users++;
+}
+
+bool
+Executable::Release()
+{
+    ASSERT(users > 0);
+    return --users == 0;
+}
+
+FileId
+Executable::GetFileId() const
+{
+    return file->GetId();
+}
+
 bool
 Executable::CheckMagic()
 {
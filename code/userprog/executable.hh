@@ -21,11 +21,24 @@
 
 
 /// Assumes that the object code file is in NOFF format.
+///
+/// An executable can be shared by processes created by `Fork`, so it
+/// counts its users, starting with one.
 class Executable {
 public:
     Executable(OpenFile *new_file);
     ~Executable();
 
+    /// Add a user.
+    void Share();
+
+    /// Remove a user, and return whether it has none left, so that it is
+    /// to be deleted.
+    bool Release();
+
+    /// Return the identity of the file; see `OpenFile::GetId`.
+    FileId GetFileId() const;
+
     /// Check if the executable is valid and fix endianness if necessary.
     ///
     /// Check if the executable conforms to the NOFF file format by checking
@@ -66,6 +79,7 @@ public:
 private:
     OpenFile *file;
     noffHeader header;
+    unsigned users;
 };
 
 
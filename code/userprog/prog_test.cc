@@ -32,6 +32,11 @@ StartProcess(const char *filename)
     }
 
     AddressSpace *space = new AddressSpace(executable, currentThread);
+    if (!space->HasSwapReserved()) {
+        printf("Not enough swap space to run %s\n", filename);
+        delete space;
+        return;
+    }
     currentThread->space = space;
 
     space->InitRegisters();  // Set the initial register values.
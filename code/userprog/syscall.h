@@ -31,6 +31,8 @@
 #define SC_CLOSE   13
 #define SC_READ    14
 #define SC_WRITE   15
+#define SC_MMAP    16
+#define SC_MUNMAP  17
 
 
 #ifndef IN_ASM
@@ -66,11 +68,15 @@ SpaceId Exec(char *name, char** args);
 int Join(SpaceId id);
 
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
+/// `Fork` and `Yield`.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
+/// Create a new process with a copy of the address space of the current one;
+/// pages are only copied when either process writes to them.
+///
+/// The new process returns 0 from `Fork`, or, if `func` is not null, starts
+/// running `func`, which must end by calling `Exit`.  The current process
+/// gets the address space identifier of the new one, to `Join` it, or -1 if
+/// there is no room in swap for the new one.
 int Fork(void (*func)(void));
 
 /// Yield the CPU to another runnable thread, whether in this address space
@@ -122,6 +128,17 @@ int Read(char *buffer, int size, OpenFileId id);
 /// Close the file, we are done reading and writing to it.
 int Close(OpenFileId id);
 
+/// Map `size` bytes of the open file, starting at `offset`, into the address
+/// space, and return where they start, or null on error.  `offset` must be a
+/// multiple of the page size.
+///
+/// The file is read as the mapped pages are touched, and changes are written
+/// back to it by `Munmap` or when the program exits.
+void *Mmap(OpenFileId id, int offset, int size);
+
+/// Remove the mapping starting at `addr`.  Return 0, or -1 on error.
+int Munmap(void *addr);
+
 
 #endif
 
@@ -0,0 +1,60 @@
+/// Routines to manage the cache of code pages.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_cache.hh"
+#include "threads/system.hh"
+
+
+PageCache::PageCache(unsigned numFrames)
+{
+    keys.resize(numFrames);
+}
+
+int
+PageCache::Lookup(FileId file, unsigned page) const
+{
+    std::map<Key, unsigned>::const_iterator it
+      = frames.find(Key(file, page));
+    return it != frames.end() ? (int) it->second : -1;
+}
+
+void
+PageCache::Insert(FileId file, unsigned page, unsigned frame)
+{
+    ASSERT(frame < keys.size());
+
+    Key key(file, page);
+    ASSERT(frames.find(key) == frames.end());
+    frames[key] = frame;
+    keys[frame] = key;
+    DEBUG('z', "Caching page %u of file %lu in frame %u\n",
+          page, file.first, frame);
+}
+
+/// The frame may have been dropped already, and its page cached again in
+/// another frame since.
+void
+PageCache::Remove(unsigned frame)
+{
+    ASSERT(frame < keys.size());
+
+    std::map<Key, unsigned>::iterator it = frames.find(keys[frame]);
+    if (it != frames.end() && it->second == frame) {
+        frames.erase(it);
+    }
+}
+
+void
+PageCache::Drop(FileId file)
+{
+    std::map<Key, unsigned>::iterator it = frames.lower_bound(Key(file, 0));
+    while (it != frames.end() && it->first.first == file) {
+        DEBUG('z', "Dropping page %u of file %lu from frame %u\n",
+              it->first.second, file.first, it->second);
+        frames.erase(it++);
+    }
+}
@@ -0,0 +1,60 @@
+/// A cache of the code pages of executables.
+///
+/// Code pages are mapped read-only, so every process running the same
+/// executable can map the same frame.  The cache tells which frame holds
+/// each code page already loaded, by executable and page number.  Frames
+/// stay in the cache when the last process mapping them exits, so that the
+/// next one to run the program finds them there, until they are evicted.
+///
+/// Executables are told apart by the identity of their file, so that a
+/// file written to, or removed and created again, is not taken for the one
+/// it was; see `OpenFile::GetId`.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_PAGECACHE__HH
+#define NACHOS_VMEM_PAGECACHE__HH
+
+
+#include "filesys/open_file.hh"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+
+class PageCache {
+public:
+
+    /// Create an empty cache for `numFrames` frames.
+    PageCache(unsigned numFrames);
+
+    /// Return the frame holding page `page` of executable `file`, or -1 if
+    /// it is not cached.
+    int Lookup(FileId file, unsigned page) const;
+
+    /// Remember that frame `frame` holds page `page` of executable `file`.
+    void Insert(FileId file, unsigned page, unsigned frame);
+
+    /// Forget the page held in frame `frame`, which is being evicted.
+    void Remove(unsigned frame);
+
+    /// Forget every page of `file`, which is being written or removed.
+    /// Processes mapping them keep them, and their frames are evicted as
+    /// usual.
+    void Drop(FileId file);
+
+private:
+
+    typedef std::pair<FileId, unsigned> Key;
+
+    std::map<Key, unsigned> frames;
+
+    /// Key of the page cached in each frame.
+    std::vector<Key> keys;
+};
+
+
+#endif
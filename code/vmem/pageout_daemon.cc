@@ -0,0 +1,95 @@
+/// Routines for the page-out daemon.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "pageout_daemon.hh"
+#include "userprog/address_space.hh"
+#include "threads/system.hh"
+
+
+PageoutDaemon::PageoutDaemon(unsigned lowWater_, unsigned highWater_)
+{
+    ASSERT(lowWater_ <= highWater_);
+    ASSERT(highWater_ < NUM_PHYS_PAGES);
+
+    lowWater = lowWater_;
+    highWater = highWater_;
+    wakeUp = new Semaphore("pageout", 0);
+    awake = false;
+    cleanCursor = 0;
+    if (lowWater > 0) {
+        Thread *t = new Thread("pageout");
+        t->Fork(Run, this);
+    }
+}
+
+PageoutDaemon::~PageoutDaemon()
+{
+    delete wakeUp;
+}
+
+unsigned
+PageoutDaemon::GetLowWater() const
+{
+    return lowWater;
+}
+
+void
+PageoutDaemon::Check()
+{
+    if (!awake && usedPages->CountClear() < lowWater) {
+        awake = true;
+        wakeUp->V();
+    }
+}
+
+void
+PageoutDaemon::Run(void *daemon_)
+{
+    PageoutDaemon *daemon = (PageoutDaemon *) daemon_;
+
+    for (;;) {
+        daemon->wakeUp->P();
+        lockCoremap->Acquire();
+        DEBUG('z', "Page-out daemon: %u frames free\n",
+              usedPages->CountClear());
+        // Give up for now if every frame is pinned: whoever pinned them
+        // is bringing pages in.  Also if no page can be reclaimed, for
+        // lack of swap slots: faults deal with that.
+        while (usedPages->CountClear() < daemon->highWater
+                 && usedPages->HasEvictable()) {
+            ReclaimResult result = AddressSpace::Reclaim();
+            if (result == RECLAIM_EVICTED) {
+                stats->numPageouts++;
+            } else if (result == RECLAIM_CLEANED) {
+                stats->numPageCleans++;
+            } else {
+                break;
+            }
+        }
+        daemon->CleanAhead();
+        daemon->awake = false;
+        lockCoremap->Release();
+    }
+}
+
+void
+PageoutDaemon::CleanAhead()
+{
+    unsigned numFrames = usedPages->GetSize();
+    unsigned cleaned = 0;
+    for (unsigned i = 0; i < numFrames && cleaned < highWater; i++) {
+        unsigned frame = cleanCursor;
+        cleanCursor = (cleanCursor + 1) % numFrames;
+        if (usedPages->IsEvictable(frame) && !usedPages->GetUse(frame)
+              && usedPages->GetDirty(frame)) {
+            if (AddressSpace::Clean(frame)) {
+                stats->numPageCleans++;
+                cleaned++;
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/// A kernel thread that evicts pages in the background.
+///
+/// Faults take free frames from the coremap.  Once fewer than a low
+/// watermark are left, the daemon is woken up; it then evicts pages until a
+/// high watermark of free frames is reached again.  Clean pages are dropped
+/// right away; dirty ones are written back first, and evicted once clean.
+/// The daemon then goes on to write back some dirty pages that have not been
+/// used lately, leaving them in memory, so that evicting them later needs no
+/// write.  As long as it keeps up, faults find a frame ready, and victims
+/// clean, and do not have to wait for a page to be written out.  If it does
+/// not, faults still evict pages themselves when no frame is free.
+///
+/// Pages are written one at a time, with `lockCoremap` released, so faults
+/// only wait for the daemon to pick its next page, not for its writes.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_PAGEOUTDAEMON__HH
+#define NACHOS_VMEM_PAGEOUTDAEMON__HH
+
+
+#include "threads/semaphore.hh"
+
+
+class PageoutDaemon {
+public:
+
+    /// Keep between `lowWater` and `highWater` frames free.  Both must be
+    /// less than the number of frames; a `lowWater` of 0 leaves the daemon
+    /// asleep forever.
+    PageoutDaemon(unsigned lowWater, unsigned highWater);
+
+    ~PageoutDaemon();
+
+    /// Wake the daemon up if free frames have gone below the low
+    /// watermark.  Called with `lockCoremap` held, after taking a frame.
+    void Check();
+
+    unsigned GetLowWater() const;
+
+private:
+
+    /// Body of the daemon thread.
+    static void Run(void *daemon);
+
+    /// Write back up to `highWater` dirty pages not used lately, going on
+    /// from where the last pass stopped.  Called with `lockCoremap` held.
+    void CleanAhead();
+
+    unsigned lowWater;
+    unsigned highWater;
+
+    Semaphore *wakeUp;
+
+    /// The daemon was woken up and has not gone back to sleep yet.
+    bool awake;
+
+    /// Next frame for `CleanAhead` to look at.
+    unsigned cleanCursor;
+};
+
+/// Default watermarks, as fractions of the number of frames.  With the
+/// default memory of 4 frames the low one is 0, so no daemon runs.
+const unsigned PAGEOUT_LOW_WATER_DIVISOR = 8;
+const unsigned PAGEOUT_HIGH_WATER_DIVISOR = 4;
+
+
+#endif
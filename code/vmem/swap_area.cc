@@ -0,0 +1,175 @@
+/// Routines to manage the swap area.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_area.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+
+SwapArea::SwapArea(const char *name_, unsigned numSlots_, unsigned cacheSize)
+{
+    ASSERT(name_ != nullptr);
+    ASSERT(numSlots_ > 0);
+
+    name = name_;
+    numSlots = numSlots_;
+    bool created = fileSystem->Create(name, numSlots * PAGE_SIZE);
+    ASSERT(created);
+    file = fileSystem->Open(name);
+    ASSERT(file != nullptr);
+    slots = new Bitmap(numSlots);
+    users = new unsigned [numSlots];
+    cursor = 0;
+    numReserved = 0;
+    cache = cacheSize > 0 ? new SwapCache(numSlots, cacheSize) : nullptr;
+    lock = new Lock("swap area");
+}
+
+SwapArea::~SwapArea()
+{
+    delete lock;
+    delete cache;
+    delete slots;
+    delete [] users;
+    delete file;
+    fileSystem->Remove(name);
+}
+
+int
+SwapArea::Allocate()
+{
+    lock->Acquire();
+    for (unsigned i = 0; i < numSlots; i++) {
+        unsigned slot = (cursor + i) % numSlots;
+        if (!slots->Test(slot)) {
+            slots->Mark(slot);
+            users[slot] = 1;
+            cursor = (slot + 1) % numSlots;
+            DEBUG('z', "Swap slot %u taken\n", slot);
+            lock->Release();
+            return slot;
+        }
+    }
+    lock->Release();
+    DEBUG('z', "Out of swap slots\n");
+    return NO_SWAP_SLOT;
+}
+
+void
+SwapArea::Share(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    lock->Acquire();
+    ASSERT(slots->Test(slot));
+    users[slot]++;
+    lock->Release();
+}
+
+void
+SwapArea::Free(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    lock->Acquire();
+    ASSERT(slots->Test(slot));
+    users[slot]--;
+    if (users[slot] == 0) {
+        slots->Clear(slot);
+        if (cache != nullptr) {
+            cache->Drop(slot);
+        }
+    }
+    lock->Release();
+}
+
+void
+SwapArea::Write(unsigned slot, const char *from)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(from != nullptr);
+
+    lock->Acquire();
+    if (cache != nullptr && cache->Put(slot, from)) {
+        Spill();
+    } else {
+        file->WriteAt(from, PAGE_SIZE, slot * PAGE_SIZE);
+    }
+    lock->Release();
+}
+
+void
+SwapArea::Spill()
+{
+    char page[PAGE_SIZE];
+    while (cache->IsOverflowing()) {
+        unsigned slot = cache->Coldest();
+        cache->Get(slot, page);
+        cache->Drop(slot);
+        file->WriteAt(page, PAGE_SIZE, slot * PAGE_SIZE);
+        stats->numSwapCacheSpills++;
+        DEBUG('z', "Swap slot %u spilled to disk\n", slot);
+    }
+}
+
+void
+SwapArea::Read(unsigned slot, char *into, unsigned count)
+{
+    ASSERT(count > 0 && slot + count <= numSlots);
+    ASSERT(into != nullptr);
+
+    lock->Acquire();
+    bool cached = false;
+    for (unsigned i = 0; cache != nullptr && i < count; i++) {
+        cached = cached || cache->Contains(slot + i);
+    }
+    if (!cached) {
+        if (cache != nullptr) {
+            stats->numSwapCacheMisses += count;
+        }
+        file->ReadAt(into, count * PAGE_SIZE, slot * PAGE_SIZE);
+        lock->Release();
+        return;
+    }
+
+    // Some are in the cache: read the rest one by one.
+    for (unsigned i = 0; i < count; i++) {
+        char *page = &into[i * PAGE_SIZE];
+        if (cache->Get(slot + i, page)) {
+            stats->numSwapCacheHits++;
+        } else {
+            stats->numSwapCacheMisses++;
+            file->ReadAt(page, PAGE_SIZE, (slot + i) * PAGE_SIZE);
+        }
+    }
+    lock->Release();
+}
+
+unsigned
+SwapArea::CountFree() const
+{
+    return slots->CountClear();
+}
+
+bool
+SwapArea::Reserve(unsigned count)
+{
+    lock->Acquire();
+    bool reserved = count <= numSlots - numReserved;
+    if (reserved) {
+        numReserved += count;
+    }
+    lock->Release();
+    return reserved;
+}
+
+void
+SwapArea::Unreserve(unsigned count)
+{
+    lock->Acquire();
+    ASSERT(count <= numReserved);
+    numReserved -= count;
+    lock->Release();
+}
@@ -0,0 +1,108 @@
+/// A swap area shared by every address space.
+///
+/// The area is a single file, divided into page sized slots.  Slots are
+/// handed out as pages get evicted, and given back when the address space
+/// owning them goes away, so creating a process costs nothing here.  A
+/// bitmap keeps track of the slots in use; it is searched from where the
+/// last slot was found, so that pages evicted one after the other end up
+/// next to each other in the file.
+///
+/// A slot can be shared by processes created by `Fork`, so slots count
+/// their users.
+///
+/// Every address space reserves, when it is created, as many slots as its
+/// program has pages, so that it can always write them all out; the sum of
+/// the reservations never goes past the size of the area.
+///
+/// Pages written to a slot go to a compressed cache first, and only reach
+/// the file once the cache overflows; see `swap_cache.hh`.
+///
+/// Pages are read and written without `lockCoremap` held, so the area has a
+/// lock of its own.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPAREA__HH
+#define NACHOS_VMEM_SWAPAREA__HH
+
+
+#include "swap_cache.hh"
+#include "filesys/open_file.hh"
+#include "lib/bitmap.hh"
+#include "threads/lock.hh"
+
+
+/// Number of slots in the swap area unless told otherwise.
+const unsigned DEFAULT_NUM_SWAP_SLOTS = 1024;
+
+/// Slot number of a page that has no slot in the swap area.
+const int NO_SWAP_SLOT = -1;
+
+class SwapArea {
+public:
+
+    /// Create the file `name`, with room for `numSlots` pages, and a cache
+    /// holding up to `cacheSize` bytes of compressed pages in front of it;
+    /// no cache if zero.
+    SwapArea(const char *name, unsigned numSlots, unsigned cacheSize = 0);
+
+    /// Close and remove the file.
+    ~SwapArea();
+
+    /// Take a free slot, with one user, or return `NO_SWAP_SLOT` if the
+    /// swap area is full.
+    int Allocate();
+
+    /// Add a user to slot `slot`.
+    void Share(unsigned slot);
+
+    /// Remove a user from slot `slot`, which is given back once it has
+    /// none left.
+    void Free(unsigned slot);
+
+    /// Copy a page from `from` into slot `slot`.
+    void Write(unsigned slot, const char *from);
+
+    /// Copy the pages in `count` slots, starting at `slot`, into `into`.
+    void Read(unsigned slot, char *into, unsigned count = 1);
+
+    /// Return the number of slots not in use.
+    unsigned CountFree() const;
+
+    /// Reserve `count` slots, or return false if that many are not left
+    /// unreserved.
+    bool Reserve(unsigned count);
+
+    /// Give back `count` reserved slots.
+    void Unreserve(unsigned count);
+
+private:
+
+    /// Write the coldest cached pages to the file until the cache fits.
+    void Spill();
+
+    const char *name;
+    OpenFile *file;
+
+    /// Protects everything below.
+    Lock *lock;
+
+    /// Compressed pages not yet written to the file, or null.
+    SwapCache *cache;
+
+    /// Slots in use, and how many users each has.
+    Bitmap *slots;
+    unsigned *users;
+    unsigned numSlots;
+
+    /// Slots reserved by the address spaces alive.
+    unsigned numReserved;
+
+    /// Where the search for the next free slot starts.
+    unsigned cursor;
+};
+
+
+#endif
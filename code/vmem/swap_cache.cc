@@ -0,0 +1,230 @@
+/// Routines to manage the compressed swap cache.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_cache.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+/// Encoding: a control byte with the high bit set stands for a run of
+/// `MIN_RUN` plus its low bits repetitions of the byte that follows; one
+/// without it, for that many plus one literal bytes that follow.
+static const unsigned MIN_RUN = 3;
+static const unsigned MAX_RUN = MIN_RUN + 0x7F;
+static const unsigned MAX_LITERALS = 0x80;
+
+/// Length of the run of equal bytes starting at `from[i]`.
+static unsigned
+RunLength(const char *from, unsigned i)
+{
+    unsigned run = 1;
+    while (i + run < PAGE_SIZE && run < MAX_RUN && from[i + run] == from[i]) {
+        run++;
+    }
+    return run;
+}
+
+/// Compress a page from `from` into `into`, which has room for a page.
+/// Return the compressed size, or `PAGE_SIZE` if it does not get smaller.
+static unsigned
+Compress(const char *from, char *into)
+{
+    unsigned in = 0;
+    unsigned out = 0;
+    while (in < PAGE_SIZE) {
+        unsigned run = RunLength(from, in);
+        if (run >= MIN_RUN) {
+            if (out + 2 >= PAGE_SIZE) {
+                return PAGE_SIZE;
+            }
+            into[out++] = (char) (0x80 | (run - MIN_RUN));
+            into[out++] = from[in];
+            in += run;
+            continue;
+        }
+        // Literals, up to the next run worth encoding.
+        unsigned start = in;
+        unsigned count = 0;
+        while (in < PAGE_SIZE && count < MAX_LITERALS
+                 && RunLength(from, in) < MIN_RUN) {
+            in++;
+            count++;
+        }
+        if (out + 1 + count >= PAGE_SIZE) {
+            return PAGE_SIZE;
+        }
+        into[out++] = (char) (count - 1);
+        memcpy(&into[out], &from[start], count);
+        out += count;
+    }
+    return out;
+}
+
+/// Decompress `size` bytes from `from` into a page at `into`.
+static void
+Decompress(const char *from, unsigned size, char *into)
+{
+    unsigned in = 0;
+    unsigned out = 0;
+    while (in < size) {
+        unsigned char control = from[in++];
+        if (control & 0x80) {
+            unsigned run = (control & 0x7F) + MIN_RUN;
+            ASSERT(in < size && out + run <= PAGE_SIZE);
+            memset(&into[out], from[in++], run);
+            out += run;
+        } else {
+            unsigned count = control + 1;
+            ASSERT(in + count <= size && out + count <= PAGE_SIZE);
+            memcpy(&into[out], &from[in], count);
+            in += count;
+            out += count;
+        }
+    }
+    ASSERT(out == PAGE_SIZE);
+}
+
+
+SwapCache::SwapCache(unsigned numSlots_, unsigned capacity_)
+{
+    ASSERT(numSlots_ > 0);
+
+    numSlots = numSlots_;
+    capacity = capacity_;
+    used = 0;
+    data = new char * [numSlots];
+    sizes = new unsigned [numSlots];
+    warmer = new int [numSlots];
+    colder = new int [numSlots];
+    for (unsigned i = 0; i < numSlots; i++) {
+        data[i] = nullptr;
+        sizes[i] = 0;
+    }
+    coldest = warmest = -1;
+}
+
+SwapCache::~SwapCache()
+{
+    for (unsigned i = 0; i < numSlots; i++) {
+        delete [] data[i];
+    }
+    delete [] data;
+    delete [] sizes;
+    delete [] warmer;
+    delete [] colder;
+}
+
+bool
+SwapCache::Put(unsigned slot, const char *page)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(page != nullptr);
+
+    Drop(slot);
+    char buffer[PAGE_SIZE];
+    unsigned size = Compress(page, buffer);
+    if (size >= PAGE_SIZE) {
+        stats->numSwapCacheRejects++;
+        return false;
+    }
+    Touch(slot);
+    data[slot] = new char [size];
+    memcpy(data[slot], buffer, size);
+    sizes[slot] = size;
+    used += size;
+
+    stats->numSwapCacheStores++;
+    stats->swapCacheBytesIn += PAGE_SIZE;
+    stats->swapCacheBytesOut += size;
+    DEBUG('z', "Swap slot %u compressed to %u bytes\n", slot, size);
+    return true;
+}
+
+bool
+SwapCache::Get(unsigned slot, char *into)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(into != nullptr);
+
+    if (data[slot] == nullptr) {
+        return false;
+    }
+    Decompress(data[slot], sizes[slot], into);
+    Touch(slot);
+    return true;
+}
+
+bool
+SwapCache::Contains(unsigned slot) const
+{
+    ASSERT(slot < numSlots);
+    return data[slot] != nullptr;
+}
+
+void
+SwapCache::Drop(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+
+    if (data[slot] == nullptr) {
+        return;
+    }
+    Unlink(slot);
+    delete [] data[slot];
+    data[slot] = nullptr;
+    used -= sizes[slot];
+    sizes[slot] = 0;
+}
+
+bool
+SwapCache::IsOverflowing() const
+{
+    return used > capacity;
+}
+
+unsigned
+SwapCache::Coldest() const
+{
+    ASSERT(coldest != -1);
+    return coldest;
+}
+
+void
+SwapCache::Touch(unsigned slot)
+{
+    if ((int) slot == warmest) {
+        return;
+    }
+    if (data[slot] != nullptr) {
+        Unlink(slot);
+    }
+    colder[slot] = warmest;
+    warmer[slot] = -1;
+    if (warmest != -1) {
+        warmer[warmest] = slot;
+    } else {
+        coldest = slot;
+    }
+    warmest = slot;
+}
+
+void
+SwapCache::Unlink(unsigned slot)
+{
+    if (colder[slot] != -1) {
+        warmer[colder[slot]] = warmer[slot];
+    } else {
+        coldest = warmer[slot];
+    }
+    if (warmer[slot] != -1) {
+        colder[warmer[slot]] = colder[slot];
+    } else {
+        warmest = colder[slot];
+    }
+}
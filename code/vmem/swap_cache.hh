@@ -0,0 +1,81 @@
+/// A pool of compressed pages kept in memory, in front of the swap area.
+///
+/// Pages written to swap are compressed and kept in the pool, so that
+/// reading them back costs no disk access.  The pool is bounded by the
+/// bytes of compressed data it holds; when it overflows, the swap area
+/// writes the coldest pages, those used least recently, to disk.  Pages
+/// that do not compress are not kept at all.
+///
+/// The codec is a simple run-length encoding, cheap enough to run on every
+/// eviction: runs of a repeated byte, as in zeroed data, shrink to two
+/// bytes, and anything else is copied with one byte of overhead for every
+/// 128.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPCACHE__HH
+#define NACHOS_VMEM_SWAPCACHE__HH
+
+
+class SwapCache {
+public:
+
+    /// Create an empty pool for the slots of a swap area of `numSlots`,
+    /// holding up to `capacity` bytes of compressed data.
+    SwapCache(unsigned numSlots, unsigned capacity);
+
+    ~SwapCache();
+
+    /// Compress `page` and keep it as the contents of slot `slot`,
+    /// replacing whatever was kept for it.  Return false, keeping nothing,
+    /// if it does not compress.
+    bool Put(unsigned slot, const char *page);
+
+    /// If slot `slot` is kept, decompress it into `into` and return true.
+    bool Get(unsigned slot, char *into);
+
+    bool Contains(unsigned slot) const;
+
+    /// Forget slot `slot`, if kept.
+    void Drop(unsigned slot);
+
+    /// Is more kept than the capacity allows?
+    bool IsOverflowing() const;
+
+    /// Return the slot used least recently among those kept.  There must
+    /// be some.
+    unsigned Coldest() const;
+
+private:
+
+    /// Make `slot` the one used most recently.
+    void Touch(unsigned slot);
+
+    /// Take `slot` out of the recency list.
+    void Unlink(unsigned slot);
+
+    unsigned numSlots;
+    unsigned capacity;
+    unsigned used;  ///< Bytes of compressed data held.
+
+    /// Compressed contents of each slot, or null if not kept, and their
+    /// sizes.
+    char **data;
+    unsigned *sizes;
+
+    /// Kept slots, in a doubly linked list from the coldest to the one
+    /// used last, or -1.
+    int *warmer;
+    int *colder;
+    int coldest;
+    int warmest;
+};
+
+/// Default capacity of the pool, in pages' worth of compressed data, as a
+/// fraction of the number of frames.
+const unsigned SWAP_CACHE_DIVISOR = 2;
+
+
+#endif